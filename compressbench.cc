@@ -0,0 +1,417 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+#include "Core/Memory/Memory.h"
+#include "Core/Memory/MallocAllocator.h"
+#include "Core/Memory/LinearAllocator.h"
+#include "Core/Memory/BlocksAllocator.h"
+#include "Core/Memory/ScratchAllocator.h"
+#include "Core/Collections/Array.h"
+#include "Core/IO/FileServer.h"
+#include "Network/ServerInstance.h"
+#include "Network/Messages/PlayerInputsWindow.h"
+
+using namespace Core::Memory;
+using namespace Network::Messages;
+
+// THCompressBench [-rooms N] [-players N] [-seconds S] [-repeat N] [-save file] [-load file]
+// Records what an in-process server sends to rooms of bot peers, uncompressed, or loads a recording
+// saved before, then replays every packet through each compressor and reports the compression ratio
+// against the time it takes per packet. Recordings are the packets as ENet compresses them,
+// without the protocol header: a 16 bits size, then the bytes.
+
+typedef std::chrono::steady_clock BenchClock;
+
+static const int kPort = 1236;
+static const uint32_t kMaxBots = 1024;
+
+struct Bot
+{
+    ENetPeer *peer;
+    uint32_t roomIndex;
+    uint32_t roomId;
+    bool playing;
+    float goTime;
+    float x, y;
+    SmartPtr<PlayerInputsWindow> inputsWindow;
+};
+
+Network::ServerInstance *serverInstance = nullptr;
+char serverInstanceBuffer[sizeof(Network::ServerInstance)];
+
+ENetHost *clientHost = nullptr;
+Bot bots[kMaxBots];
+uint32_t botsCount = 0, playersPerRoom = 4;
+uint32_t connectedBots = 0, playingBots = 0;
+
+bool recording = false;
+Core::IO::BitStream *packets = nullptr;
+
+static int ENET_CALLBACK
+RecordPacket(ENetHost *host, ENetEvent *event)
+{
+    if (!recording || host->receivedDataLength < sizeof(ENetProtocolHeader))
+        return 0;
+
+    // what the sender's compressor would have got
+    const ENetProtocolHeader *header = (const ENetProtocolHeader*)host->receivedData;
+    size_t headerSize = (ENET_NET_TO_HOST_16(header->peerID) & ENET_PROTOCOL_HEADER_FLAG_SENT_TIME ? sizeof(ENetProtocolHeader) : (size_t)&((ENetProtocolHeader*)0)->sentTime);
+
+    uint16_t size = (uint16_t)(host->receivedDataLength - headerSize);
+    *packets << size;
+    packets->WriteBytes(host->receivedData + headerSize, size);
+    return 0;
+}
+
+static void
+Send(Bot &bot, const SmartPtr<Network::Serializable> &message, Network::HostInstance::MessageType messageType, uint8_t channel)
+{
+    Core::IO::BitStream stream(GetAllocator<MallocAllocator>());
+    message->Serialize(bot.peer, stream);
+    enet_peer_send(bot.peer, channel, enet_packet_create(stream.GetData(), stream.GetSize(), Network::HostInstance::MessageTypeToFlags(messageType)));
+}
+
+static void
+Receive(Bot &bot, const ENetPacket *packet)
+{
+    Core::IO::BitStream stream(GetAllocator<MallocAllocator>(), packet->data, packet->dataLength, false);
+    if (stream.RemainingBits() < 32)
+        return;
+
+    uint32_t fcc;
+    stream >> fcc;
+    stream.Rewind();
+
+    if (CreateRoom::RTTI.GetFCC() == fcc)
+    { // the room's first bot made it, everybody joins
+        auto createRoom = SmartPtr<CreateRoom>::MakeNew<BlocksAllocator>();
+        createRoom->Deserialize(bot.peer, stream);
+
+        for (uint32_t i = 0; i < botsCount; ++i)
+        {
+            if (bots[i].roomIndex != bot.roomIndex)
+                continue;
+
+            auto joinRoom = SmartPtr<JoinRoom>::MakeNew<BlocksAllocator>();
+            joinRoom->roomId = createRoom->roomId;
+            joinRoom->flags = JoinRoom::Request;
+            Send(bots[i], SmartPtr<Network::Serializable>::CastFrom(joinRoom), Network::HostInstance::ReliableSequenced, 1);
+        }
+    }
+    else if (JoinRoom::RTTI.GetFCC() == fcc)
+    {
+        auto joinRoom = SmartPtr<JoinRoom>::MakeNew<BlocksAllocator>();
+        joinRoom->Deserialize(bot.peer, stream);
+        if (joinRoom->flags != JoinRoom::Success)
+            return;
+
+        bot.roomId = joinRoom->roomId;
+
+        auto startGame = SmartPtr<StartGame>::MakeNew<BlocksAllocator>();
+        startGame->roomId = bot.roomId;
+        startGame->playerId = StartGame::kUnknownId;
+        startGame->flags = StartGame::Ready;
+        startGame->goTime = .0f;
+        Send(bot, SmartPtr<Network::Serializable>::CastFrom(startGame), Network::HostInstance::ReliableSequenced, 1);
+    }
+    else if (StartGame::RTTI.GetFCC() == fcc)
+    {
+        auto startGame = SmartPtr<StartGame>::MakeNew<BlocksAllocator>();
+        startGame->Deserialize(bot.peer, stream);
+        if (startGame->flags != StartGame::Go)
+            return;
+
+        bot.playing = true;
+        bot.goTime = startGame->goTime;
+        ++playingBots;
+    }
+}
+
+static void
+ServiceBots()
+{
+    ENetEvent event;
+    while (enet_host_service(clientHost, &event, 0) > 0)
+    {
+        do
+        {
+            Bot &bot = bots[(size_t)event.peer->data];
+            switch (event.type)
+            {
+            case ENET_EVENT_TYPE_CONNECT:
+                ++connectedBots;
+                break;
+            case ENET_EVENT_TYPE_DISCONNECT:
+                --connectedBots;
+                break;
+            case ENET_EVENT_TYPE_RECEIVE:
+                Receive(bot, event.packet);
+                enet_packet_destroy(event.packet);
+                break;
+            default:
+                break;
+            }
+        } while (enet_host_check_events(clientHost, &event) > 0);
+    }
+}
+
+static void
+SendInputs()
+{ // wandering around, attacking now and then
+    float now = Core::Time::TimeServer::Instance()->GetSeconds();
+    for (uint32_t i = 0; i < botsCount; ++i)
+    {
+        Bot &bot = bots[i];
+        if (!bot.playing || now < bot.goTime)
+            continue;
+
+        if (rand() % 32 == 0)
+        {
+            bot.x = (rand() % 201 - 100) * 0.01f;
+            bot.y = (rand() % 201 - 100) * 0.01f;
+        }
+
+        uint32_t step = (uint32_t)((now - bot.goTime) / Network::HostInstance::kFixedTimeStep);
+        if (bot.inputsWindow->count > 0 && step <= bot.inputsWindow->inputs[0].step)
+            continue;
+
+        bot.inputsWindow->Push(step, bot.x, bot.y, rand() % 64 == 0);
+        Send(bot, SmartPtr<Network::Serializable>::CastFrom(bot.inputsWindow), Network::HostInstance::Unsequenced, 0);
+    }
+}
+
+static void
+Tick()
+{
+    ServiceBots();
+    serverInstance->Tick(false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+static bool
+Record(uint32_t roomsCount, float seconds)
+{
+    const Network::HostInstance::HostSettings &hostSettings = serverInstance->GetHostSettings();
+
+    botsCount = std::min(roomsCount * playersPerRoom, kMaxBots);
+    clientHost = enet_host_create(nullptr, botsCount, hostSettings.channelsCount, 0, 0);
+    if (nullptr == clientHost)
+        return false;
+
+    clientHost->intercept = &RecordPacket;
+
+    ENetAddress address;
+    enet_address_set_host(&address, "127.0.0.1");
+    address.port = kPort;
+
+    for (uint32_t i = 0; i < botsCount; ++i)
+    {
+        Bot &bot = bots[i];
+        bot.peer = enet_host_connect(clientHost, &address, hostSettings.channelsCount, 0);
+        bot.peer->data = (void*)(size_t)i;
+        bot.roomIndex = i / playersPerRoom;
+        bot.playing = false;
+        bot.x = bot.y = .0f;
+        bot.inputsWindow = SmartPtr<PlayerInputsWindow>::MakeNew<BlocksAllocator>();
+    }
+
+    BenchClock::time_point timeout = BenchClock::now() + std::chrono::seconds(30);
+    while (connectedBots < botsCount && BenchClock::now() < timeout)
+        Tick();
+
+    for (uint32_t i = 0; i < botsCount; i += playersPerRoom)
+    {
+        auto createRoom = SmartPtr<CreateRoom>::MakeNew<BlocksAllocator>();
+        createRoom->roomId = CreateRoom::kUnknownId;
+        createRoom->playersCount = (uint8_t)std::min(playersPerRoom, botsCount - i);
+        Send(bots[i], SmartPtr<Network::Serializable>::CastFrom(createRoom), Network::HostInstance::ReliableSequenced, 1);
+    }
+
+    while (playingBots < botsCount && BenchClock::now() < timeout)
+        Tick();
+
+    bool recorded = false;
+    if (playingBots < botsCount)
+        std::cout << "only " << playingBots << " of " << botsCount << " bots started playing" << std::endl;
+    else
+    {
+        BenchClock::time_point end = BenchClock::now() + std::chrono::microseconds((int)(seconds * 1000000.0f));
+
+        recording = true;
+        while (BenchClock::now() < end)
+        {
+            SendInputs();
+            Tick();
+        }
+        recording = false;
+
+        recorded = true;
+    }
+
+    for (uint32_t i = 0; i < botsCount; ++i)
+        bots[i].inputsWindow.Reset();
+
+    enet_host_destroy(clientHost);
+    clientHost = nullptr;
+
+    return recorded;
+}
+
+static void
+Measure(Network::HostInstance::Compressor compressor, const Core::Collections::Array<const uint8_t*> &packetsData, const Core::Collections::Array<uint16_t> &packetsSizes, uint32_t repeat)
+{
+    ENetHost *host = enet_host_create(nullptr, 1, 1, 0, 0);
+    Network::HostInstance::SetCompressor(host, compressor);
+    const ENetCompressor &c = host->compressor;
+
+    uint8_t compressed[ENET_PROTOCOL_MAXIMUM_MTU], decompressed[ENET_PROTOCOL_MAXIMUM_MTU];
+
+    uint64_t inBytes = 0, outBytes = 0;
+    uint32_t failures = 0;
+    double compressTime = 0.0, decompressTime = 0.0;
+    for (uint32_t r = 0; r < repeat; ++r)
+    {
+        for (uint32_t i = 0; i < packetsData.Count(); ++i)
+        {
+            ENetBuffer buffer;
+            buffer.data = (void*)packetsData[i];
+            buffer.dataLength = packetsSizes[i];
+
+            // ENet sends the packet as it is if it doesn't shrink
+            size_t size = buffer.dataLength;
+            if (c.compress != nullptr)
+            {
+                BenchClock::time_point start = BenchClock::now();
+                size_t compressedSize = c.compress(c.context, &buffer, 1, buffer.dataLength, compressed, buffer.dataLength);
+                compressTime += std::chrono::duration<double, std::micro>(BenchClock::now() - start).count();
+
+                if (compressedSize > 0 && compressedSize < size)
+                {
+                    start = BenchClock::now();
+                    size_t decompressedSize = c.decompress(c.context, compressed, compressedSize, decompressed, sizeof(decompressed));
+                    decompressTime += std::chrono::duration<double, std::micro>(BenchClock::now() - start).count();
+
+                    if (decompressedSize != buffer.dataLength || memcmp(decompressed, buffer.data, decompressedSize) != 0)
+                        ++failures;
+
+                    size = compressedSize;
+                }
+            }
+
+            inBytes += buffer.dataLength;
+            outBytes += size;
+        }
+    }
+
+    double packetsCount = (double)packetsData.Count() * repeat;
+    Core::Log::Instance()->Write(Core::Log::Info, "%6s: %6.2f%% of the size, %7.3f us/packet compress, %7.3f us/packet decompress%s",
+        Network::HostInstance::GetCompressorName(compressor),
+        100.0 * outBytes / inBytes,
+        compressTime / packetsCount,
+        decompressTime / packetsCount,
+        failures > 0 ? ", ROUND TRIP FAILED" : "");
+
+    enet_host_destroy(host);
+}
+
+int main(int argc, char **argv) {
+    InitializeMemory();
+
+    InitAllocator<MallocAllocator>();
+    InitAllocator<LinearAllocator>(&GetAllocator<MallocAllocator>(), 1 * 1024 * 1024, 16);
+    InitAllocator<BlocksAllocator>(&GetAllocator<MallocAllocator>(), 8192);
+    InitAllocator<ScratchAllocator>(&GetAllocator<MallocAllocator>(), 512 * 1024);
+
+    Core::ClassInfoUtils::Instance()->Initialize();
+
+    uint32_t roomsCount = 16, repeat = 10;
+    float seconds = 5.0f;
+    const char *savePath = nullptr, *loadPath = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (0 == strcmp(argv[i], "-rooms"))
+            roomsCount = std::max(1u, (uint32_t)strtoul(argv[i + 1], nullptr, 10));
+        else if (0 == strcmp(argv[i], "-players"))
+            playersPerRoom = std::max(1u, (uint32_t)strtoul(argv[i + 1], nullptr, 10));
+        else if (0 == strcmp(argv[i], "-seconds"))
+            seconds = (float)atof(argv[i + 1]);
+        else if (0 == strcmp(argv[i], "-repeat"))
+            repeat = std::max(1u, (uint32_t)strtoul(argv[i + 1], nullptr, 10));
+        else if (0 == strcmp(argv[i], "-save"))
+            savePath = argv[i + 1];
+        else if (0 == strcmp(argv[i], "-load"))
+            loadPath = argv[i + 1];
+    }
+
+    serverInstance = new(serverInstanceBuffer) Network::ServerInstance();
+    Core::Log::Instance()->SetCallback([](int msgType, const char *msg)
+    {
+        std::cout << msg << std::endl;
+    });
+
+    // recorded uncompressed, what the compressors get is what ENet would give them
+    Network::HostInstance::HostSettings hostSettings;
+    hostSettings.compressor = Network::HostInstance::NoCompressor;
+    serverInstance->SetHostSettings(hostSettings);
+
+    if (serverInstance->Initialize(kPort, 1))
+    {
+        auto fileServer = SmartPtr<Core::IO::FileServer>::MakeNew<LinearAllocator>();
+        Core::IO::BitStream recorded(GetAllocator<MallocAllocator>());
+        packets = &recorded;
+
+        bool hasPackets;
+        if (loadPath != nullptr)
+        {
+            hasPackets = (0 == fileServer->ReadOnly(loadPath, recorded));
+            if (hasPackets)
+                std::cout << "loaded " << recorded.GetSize() << " bytes from " << loadPath << std::endl;
+        }
+        else
+        {
+            hasPackets = Record(roomsCount, seconds);
+            if (hasPackets && savePath != nullptr)
+                fileServer->WriteOnly(savePath, recorded);
+        }
+
+        if (hasPackets)
+        {
+            Core::Collections::Array<const uint8_t*> packetsData(GetAllocator<MallocAllocator>());
+            Core::Collections::Array<uint16_t> packetsSizes(GetAllocator<MallocAllocator>());
+
+            recorded.Rewind();
+            while (recorded.RemainingBytes() >= sizeof(uint16_t))
+            {
+                uint16_t size;
+                recorded >> size;
+                if (recorded.RemainingBytes() < size)
+                    break;
+
+                packetsData.PushBack(static_cast<const uint8_t*>(recorded.GetReadPos()));
+                packetsSizes.PushBack(size);
+                recorded.SkipBytes(size);
+            }
+
+            Core::Log::Instance()->Write(Core::Log::Info, "%u packets, replayed %u times.", packetsData.Count(), repeat);
+            for (uint32_t i = 0; i < Network::HostInstance::CompressorsCount; ++i)
+                Measure((Network::HostInstance::Compressor)i, packetsData, packetsSizes, repeat);
+        }
+
+        packets = nullptr;
+    }
+
+    serverInstance->RequestStop();
+    serverInstance->~ServerInstance();
+    serverInstance = nullptr;
+
+    Core::RefCounted::GC.Collect();
+    Core::ClassInfoUtils::Destroy();
+
+    ShutdownMemory();
+
+    return 0;
+}
@@ -83,6 +83,11 @@ extern "C"
         clientInstance->JoinRoom(roomId, callback);
     }
 
+    void EXPORT_API GameQuickJoin(uint8_t playersCount, Network::ClientInstance::JoinRoomCallback callback)
+    {
+        clientInstance->QuickJoin(playersCount, callback);
+    }
+
     void EXPORT_API GameStart(Network::ClientInstance::StartGameCallback callback)
     {
         clientInstance->StartGame(callback);
@@ -108,6 +113,11 @@ extern "C"
         clientInstance->GetEnemyPosition(0, x, y);
     }
 
+    uint8_t EXPORT_API GameReceiveEnemyHealth()
+    {
+        return clientInstance->GetEnemyHealth(0);
+    }
+
     void EXPORT_API GamePause()
     {
         clientInstance->RequestPause();
@@ -84,6 +84,7 @@ enet_host_create (const ENetAddress * address, size_t peerCount, size_t channelL
     host -> recalculateBandwidthLimits = 0;
     host -> mtu = ENET_HOST_DEFAULT_MTU;
     host -> peerCount = peerCount;
+    host -> activePeerCount = 0;
     host -> commandCount = 0;
     host -> bufferCount = 0;
     host -> checksum = NULL;
@@ -194,6 +195,9 @@ enet_host_connect (ENetHost * host, const ENetAddress * address, size_t channelC
     if (currentPeer >= & host -> peers [host -> peerCount])
       return NULL;
 
+    if ((size_t) (currentPeer - host -> peers) >= host -> activePeerCount)
+      host -> activePeerCount = currentPeer - host -> peers + 1;
+
     currentPeer -> channels = (ENetChannel *) enet_malloc (channelCount * sizeof (ENetChannel));
     if (currentPeer -> channels == NULL)
       return NULL;
@@ -263,7 +267,7 @@ enet_host_broadcast (ENetHost * host, enet_uint8 channelID, ENetPacket * packet)
     ENetPeer * currentPeer;
 
     for (currentPeer = host -> peers;
-         currentPeer < & host -> peers [host -> peerCount];
+         currentPeer < & host -> peers [host -> activePeerCount];
          ++ currentPeer)
     {
        if (currentPeer -> state != ENET_PEER_STATE_CONNECTED)
@@ -352,7 +356,7 @@ enet_host_bandwidth_throttle (ENetHost * host)
         bandwidth = (host -> outgoingBandwidth * elapsedTime) / 1000;
 
         for (peer = host -> peers;
-             peer < & host -> peers [host -> peerCount];
+             peer < & host -> peers [host -> activePeerCount];
             ++ peer)
         {
             if (peer -> state != ENET_PEER_STATE_CONNECTED && peer -> state != ENET_PEER_STATE_DISCONNECT_LATER)
@@ -372,7 +376,7 @@ enet_host_bandwidth_throttle (ENetHost * host)
           throttle = (bandwidth * ENET_PEER_PACKET_THROTTLE_SCALE) / dataTotal;
 
         for (peer = host -> peers;
-             peer < & host -> peers [host -> peerCount];
+             peer < & host -> peers [host -> activePeerCount];
              ++ peer)
         {
             enet_uint32 peerBandwidth;
@@ -415,7 +419,7 @@ enet_host_bandwidth_throttle (ENetHost * host)
           throttle = (bandwidth * ENET_PEER_PACKET_THROTTLE_SCALE) / dataTotal;
 
         for (peer = host -> peers;
-             peer < & host -> peers [host -> peerCount];
+             peer < & host -> peers [host -> activePeerCount];
              ++ peer)
         {
             if ((peer -> state != ENET_PEER_STATE_CONNECTED && peer -> state != ENET_PEER_STATE_DISCONNECT_LATER) ||
@@ -449,7 +453,7 @@ enet_host_bandwidth_throttle (ENetHost * host)
            bandwidthLimit = bandwidth / peersRemaining;
 
            for (peer = host -> peers;
-                peer < & host -> peers [host -> peerCount];
+                peer < & host -> peers [host -> activePeerCount];
                 ++ peer)
            {
                if ((peer -> state != ENET_PEER_STATE_CONNECTED && peer -> state != ENET_PEER_STATE_DISCONNECT_LATER) ||
@@ -469,7 +473,7 @@ enet_host_bandwidth_throttle (ENetHost * host)
        }
 
        for (peer = host -> peers;
-            peer < & host -> peers [host -> peerCount];
+            peer < & host -> peers [host -> activePeerCount];
             ++ peer)
        {
            if (peer -> state != ENET_PEER_STATE_CONNECTED && peer -> state != ENET_PEER_STATE_DISCONNECT_LATER)
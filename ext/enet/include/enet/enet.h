@@ -62,7 +62,8 @@ typedef enum _ENetSocketOption
    ENET_SOCKOPT_RCVTIMEO  = 6,
    ENET_SOCKOPT_SNDTIMEO  = 7,
    ENET_SOCKOPT_ERROR     = 8,
-   ENET_SOCKOPT_NODELAY   = 9
+   ENET_SOCKOPT_NODELAY   = 9,
+   ENET_SOCKOPT_REUSEPORT = 10
 } ENetSocketOption;
 
 typedef enum _ENetSocketShutdown
@@ -326,6 +327,13 @@ typedef struct _ENetPeer
    enet_uint32   unsequencedWindow [ENET_PEER_UNSEQUENCED_WINDOW_SIZE / 32]; 
    enet_uint32   eventData;
    size_t        totalWaitingData;
+   enet_uint32   totalSentData;                  /**< bytes of UDP packets sent to the peer, compressed, user should reset to 0 as needed */
+   enet_uint32   totalSentUncompressedData;      /**< the same bytes before compression */
+   enet_uint32   totalSentPackets;               /**< UDP packets sent to the peer */
+   enet_uint32   totalReceivedData;              /**< bytes of UDP packets received from the peer, compressed */
+   enet_uint32   totalReceivedUncompressedData;  /**< the same bytes after decompression */
+   enet_uint32   totalReceivedPackets;           /**< UDP packets received from the peer */
+   enet_uint32   totalResentCommands;            /**< reliable commands sent again after their round trip timeout */
 } ENetPeer;
 
 /** An ENet packet compressor for compressing UDP packets before socket sends or receives.
@@ -376,6 +384,7 @@ typedef struct _ENetHost
    int                  recalculateBandwidthLimits;
    ENetPeer *           peers;                       /**< array of peers allocated for this host */
    size_t               peerCount;                   /**< number of peers allocated for this host */
+   size_t               activePeerCount;             /**< peers past this index are all disconnected, bounds the per-service peer scans */
    size_t               channelLimit;                /**< maximum number of channels allowed for connected peers */
    enet_uint32          serviceTime;
    ENetList             dispatchQueue;
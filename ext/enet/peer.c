@@ -410,6 +410,13 @@ enet_peer_reset (ENetPeer * peer)
     peer -> outgoingBandwidthThrottleEpoch = 0;
     peer -> incomingDataTotal = 0;
     peer -> outgoingDataTotal = 0;
+    peer -> totalSentData = 0;
+    peer -> totalSentUncompressedData = 0;
+    peer -> totalSentPackets = 0;
+    peer -> totalReceivedData = 0;
+    peer -> totalReceivedUncompressedData = 0;
+    peer -> totalReceivedPackets = 0;
+    peer -> totalResentCommands = 0;
     peer -> lastSendTime = 0;
     peer -> lastReceiveTime = 0;
     peer -> nextTimeout = 0;
@@ -288,7 +288,7 @@ enet_protocol_handle_connect (ENetHost * host, ENetProtocolHeader * header, ENet
       return NULL;
 
     for (currentPeer = host -> peers;
-         currentPeer < & host -> peers [host -> peerCount];
+         currentPeer < & host -> peers [host -> activePeerCount];
          ++ currentPeer)
     {
         if (currentPeer -> state == ENET_PEER_STATE_DISCONNECTED)
@@ -308,9 +308,15 @@ enet_protocol_handle_connect (ENetHost * host, ENetProtocolHeader * header, ENet
         }
     }
 
+    if (peer == NULL && host -> activePeerCount < host -> peerCount)
+      peer = & host -> peers [host -> activePeerCount];
+
     if (peer == NULL || duplicatePeers >= host -> duplicatePeers)
       return NULL;
 
+    if ((size_t) (peer - host -> peers) >= host -> activePeerCount)
+      host -> activePeerCount = peer - host -> peers + 1;
+
     if (channelCount > host -> channelLimit)
       channelCount = host -> channelLimit;
     peer -> channels = (ENetChannel *) enet_malloc (channelCount * sizeof (ENetChannel));
@@ -1024,6 +1030,12 @@ enet_protocol_handle_incoming_commands (ENetHost * host, ENetEvent * event)
             sessionID != peer -> incomingSessionID))
          return 0;
     }
+
+    if (peer != NULL)
+    {
+       peer -> totalReceivedData += host -> receivedDataLength;
+       peer -> totalReceivedPackets ++;
+    }
  
     if (flags & ENET_PROTOCOL_HEADER_FLAG_COMPRESSED)
     {
@@ -1064,6 +1076,7 @@ enet_protocol_handle_incoming_commands (ENetHost * host, ENetEvent * event)
        peer -> address.host = host -> receivedAddress.host;
        peer -> address.port = host -> receivedAddress.port;
        peer -> incomingDataTotal += host -> receivedDataLength;
+       peer -> totalReceivedUncompressedData += host -> receivedDataLength;
     }
     
     currentData = host -> receivedData + headerSize;
@@ -1454,6 +1467,7 @@ enet_protocol_check_timeouts (ENetHost * host, ENetPeer * peer, ENetEvent * even
          peer -> reliableDataInTransit -= outgoingCommand -> fragmentLength;
           
        ++ peer -> packetsLost;
+       ++ peer -> totalResentCommands;
 
        outgoingCommand -> roundTripTimeout *= 2;
 
@@ -1602,18 +1616,23 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
     ENetProtocolHeader * header = (ENetProtocolHeader *) headerData;
     ENetPeer * currentPeer;
     int sentLength;
-    size_t shouldCompress = 0;
+    size_t shouldCompress = 0, activePeerCount;
  
     host -> continueSending = 1;
 
     while (host -> continueSending)
     for (host -> continueSending = 0,
+           activePeerCount = 0,
            currentPeer = host -> peers;
-         currentPeer < & host -> peers [host -> peerCount];
+         currentPeer < & host -> peers [host -> activePeerCount];
          ++ currentPeer)
     {
-        if (currentPeer -> state == ENET_PEER_STATE_DISCONNECTED ||
-            currentPeer -> state == ENET_PEER_STATE_ZOMBIE)
+        if (currentPeer -> state == ENET_PEER_STATE_DISCONNECTED)
+          continue;
+
+        activePeerCount = currentPeer - host -> peers + 1;
+
+        if (currentPeer -> state == ENET_PEER_STATE_ZOMBIE)
           continue;
 
         host -> headerFlags = 0;
@@ -1739,7 +1758,14 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
 
         host -> totalSentData += sentLength;
         host -> totalSentPackets ++;
+
+        currentPeer -> totalSentData += sentLength;
+        currentPeer -> totalSentUncompressedData += shouldCompress > 0 ? sentLength - shouldCompress + host -> packetSize - sizeof (ENetProtocolHeader) : sentLength;
+        currentPeer -> totalSentPackets ++;
     }
+
+    /* peers at the end that got disconnected since the last pass are not scanned anymore */
+    host -> activePeerCount = activePeerCount;
    
     return 0;
 }
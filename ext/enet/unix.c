@@ -313,6 +313,12 @@ enet_socket_set_option (ENetSocket socket, ENetSocketOption option, int value)
             result = setsockopt (socket, SOL_SOCKET, SO_REUSEADDR, (char *) & value, sizeof (int));
             break;
 
+        case ENET_SOCKOPT_REUSEPORT:
+#ifdef SO_REUSEPORT
+            result = setsockopt (socket, SOL_SOCKET, SO_REUSEPORT, (char *) & value, sizeof (int));
+#endif
+            break;
+
         case ENET_SOCKOPT_RCVBUF:
             result = setsockopt (socket, SOL_SOCKET, SO_RCVBUF, (char *) & value, sizeof (int));
             break;
@@ -0,0 +1,313 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+#include "Core/Memory/Memory.h"
+#include "Core/Memory/MallocAllocator.h"
+#include "Core/Memory/LinearAllocator.h"
+#include "Core/Memory/BlocksAllocator.h"
+#include "Core/Memory/ScratchAllocator.h"
+#include "Core/Collections/Array.h"
+#include "Network/ServerInstance.h"
+#include "Network/ClientInstance.h"
+
+using namespace Core::Memory;
+
+// THLoadTest [-rooms N] [-players N] [-seconds S] [-shards N] [-compressor none|range|lz] [-quickjoin 0|1]
+// Runs a server and headless bots in one process, every bot a ClientInstance connected over loopback.
+// Bots create and join rooms (or quick join, letting the server fill rooms), start the game and walk
+// a scripted path, one input per sim step.
+// Rooms double from 1 up to N, at each step the server gets measured while it runs them:
+// what a Tick costs and how much of the time it keeps the main thread busy, the bandwidth
+// per room, the latency from an input to the snapshot confirming it, and how often the bots'
+// prediction got corrected. The rooms a core holds is where busy gets to 100%.
+
+typedef std::chrono::steady_clock BenchClock;
+
+static const int kPort = 1237;
+static const uint32_t kMaxBots = 1024;
+
+struct Bot
+{
+    Network::ClientInstance *client;
+    uint32_t roomIndex;
+    bool joining;
+    bool starting;
+    uint32_t lastInputStep;
+
+    Network::NetStats::PeerStats peerStats; // totals when the measure started
+};
+
+Network::ServerInstance *serverInstance = nullptr;
+char serverInstanceBuffer[sizeof(Network::ServerInstance)];
+
+Bot bots[kMaxBots];
+uint32_t botsCount = 0, playersPerRoom = 4;
+uint32_t roomIds[kMaxBots];
+
+// ClientInstance callbacks carry no context, they run within the bot's own calls
+Bot *currentBot = nullptr;
+bool verbose = true;
+bool quickJoin = false;
+
+static void
+OnRoomCreated(uint32_t roomId)
+{
+    roomIds[currentBot->roomIndex] = roomId;
+}
+
+static void
+OnJoinedRoom(bool success)
+{
+    currentBot->joining = false;
+}
+
+static void
+OnGameStarted(bool success)
+{
+    currentBot->starting = false;
+}
+
+static void
+TickBot(Bot &bot)
+{
+    currentBot = &bot;
+    bot.client->Tick();
+
+    Network::ClientInstance::State state = bot.client->GetState();
+    if (Network::ClientInstance::Connected == state && !bot.joining && quickJoin)
+    {
+        bot.joining = true;
+        bot.client->QuickJoin((uint8_t)playersPerRoom, &OnJoinedRoom);
+    }
+    else if (Network::ClientInstance::Connected == state && !bot.joining && roomIds[bot.roomIndex] != Network::Messages::CreateRoom::kUnknownId)
+    {
+        bot.joining = true;
+        bot.client->JoinRoom(roomIds[bot.roomIndex], &OnJoinedRoom);
+    }
+    else if (Network::ClientInstance::JoinedRoom == state && !bot.starting)
+    {
+        bot.starting = true;
+        bot.client->StartGame(&OnGameStarted);
+    }
+    else if (Network::ClientInstance::Playing == state)
+    {
+        uint32_t step = bot.client->GetSimStep();
+        if (step != bot.lastInputStep)
+        { // circling, every bot from its own angle, an attack every couple of seconds
+            uint32_t index = (uint32_t)(&bot - bots);
+            float angle = step * 0.02f + index * 0.7f;
+            bot.client->SendPlayerInputs(cosf(angle), sinf(angle), 0 == (step + index * 7) % 128);
+            bot.lastInputStep = step;
+        }
+    }
+
+    currentBot = nullptr;
+}
+
+static double
+Tick()
+{
+    for (uint32_t i = 0; i < botsCount; ++i)
+        TickBot(bots[i]);
+
+    BenchClock::time_point tickStart = BenchClock::now();
+    serverInstance->Tick(false);
+    double tickTime = std::chrono::duration<double, std::micro>(BenchClock::now() - tickStart).count();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    return tickTime;
+}
+
+static uint32_t
+CountBots(Network::ClientInstance::State state)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < botsCount; ++i)
+        count += (bots[i].client->GetState() >= state ? 1 : 0);
+    return count;
+}
+
+static bool
+AddRooms(uint32_t roomsCount)
+{
+    uint32_t firstBot = botsCount;
+    uint32_t newBotsCount = std::min(roomsCount * playersPerRoom, kMaxBots);
+    for (uint32_t i = firstBot; i < newBotsCount; ++i)
+    {
+        Bot &bot = bots[i];
+        bot.client = New<MallocAllocator, Network::ClientInstance>();
+        bot.client->SetHostSettings(serverInstance->GetHostSettings());
+        bot.roomIndex = i / playersPerRoom;
+        bot.joining = bot.starting = false;
+        bot.lastInputStep = 0;
+        roomIds[bot.roomIndex] = Network::Messages::CreateRoom::kUnknownId;
+
+        if (!bot.client->Initialize("127.0.0.1", kPort))
+            return false;
+    }
+    botsCount = newBotsCount;
+
+    BenchClock::time_point timeout = BenchClock::now() + std::chrono::seconds(30);
+    while (CountBots(Network::ClientInstance::Connected) < botsCount && BenchClock::now() < timeout)
+        Tick();
+
+    // the first bot of every new room makes it, the others join once its id is there
+    for (uint32_t i = firstBot; i < botsCount && !quickJoin; i += playersPerRoom)
+    {
+        currentBot = &bots[i];
+        bots[i].client->CreateRoom((uint8_t)std::min(playersPerRoom, botsCount - i), &OnRoomCreated);
+        currentBot = nullptr;
+    }
+
+    while (CountBots(Network::ClientInstance::Playing) < botsCount && BenchClock::now() < timeout)
+        Tick();
+
+    uint32_t playingBots = CountBots(Network::ClientInstance::Playing);
+    if (playingBots < botsCount)
+    {
+        std::cout << "only " << playingBots << " of " << botsCount << " bots started playing" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static void
+Measure(uint32_t roomsCount, float seconds)
+{
+    for (uint32_t i = 0; i < botsCount; ++i)
+    {
+        bots[i].client->ResetGameStats();
+        bots[i].client->GetPeerStats(bots[i].peerStats);
+    }
+
+    BenchClock::time_point start = BenchClock::now(),
+                           end = start + std::chrono::microseconds((int)(seconds * 1000000.0f));
+
+    uint32_t ticks = 0;
+    double totalTime = 0.0, maxTime = 0.0;
+    while (BenchClock::now() < end)
+    {
+        double tickTime = Tick();
+
+        totalTime += tickTime;
+        maxTime = std::max(maxTime, tickTime);
+        ++ticks;
+    }
+    double elapsed = std::chrono::duration<double>(BenchClock::now() - start).count();
+
+    // what the bots received is what the server sent
+    uint64_t bytes = 0, uncompressedBytes = 0;
+    uint32_t snapshots = 0, corrections = 0, confirmedInputs = 0;
+    float inputLatency = .0f, maxInputLatency = .0f;
+    for (uint32_t i = 0; i < botsCount; ++i)
+    {
+        const Bot &bot = bots[i];
+
+        Network::NetStats::PeerStats peerStats;
+        if (bot.client->GetPeerStats(peerStats))
+        {
+            bytes += peerStats.receivedBytes - bot.peerStats.receivedBytes;
+            uncompressedBytes += peerStats.receivedUncompressedBytes - bot.peerStats.receivedUncompressedBytes;
+        }
+
+        const Network::ClientInstance::GameStats &gameStats = bot.client->GetGameStats();
+        snapshots += gameStats.snapshots;
+        corrections += gameStats.corrections;
+        confirmedInputs += gameStats.confirmedInputs;
+        inputLatency += gameStats.inputLatency;
+        maxInputLatency = std::max(maxInputLatency, gameStats.maxInputLatency);
+    }
+
+    double busy = totalTime / (elapsed * 1000000.0);
+    verbose = true;
+    Core::Log::Instance()->Write(Core::Log::Info, "%4u rooms: %8.2f us/tick avg, %8.2f us max, busy %6.2f%% (~%u rooms/core)",
+        roomsCount, totalTime / ticks, maxTime, busy * 100.0, (uint32_t)(roomsCount / std::max(busy, 0.0001)));
+    Core::Log::Instance()->Write(Core::Log::Info, "            %7.2f KB/s per room (%.2f uncompressed), input latency %.1f ms avg %.1f ms max, %.2f%% snapshots corrected",
+        bytes / (1024.0 * elapsed * roomsCount), uncompressedBytes / (1024.0 * elapsed * roomsCount),
+        confirmedInputs > 0 ? inputLatency * 1000.0f / confirmedInputs : .0f, maxInputLatency * 1000.0f,
+        snapshots > 0 ? corrections * 100.0f / snapshots : .0f);
+    verbose = false;
+}
+
+int main(int argc, char **argv) {
+    InitializeMemory();
+
+    InitAllocator<MallocAllocator>();
+    InitAllocator<LinearAllocator>(&GetAllocator<MallocAllocator>(), 1 * 1024 * 1024, 16);
+    InitAllocator<BlocksAllocator>(&GetAllocator<MallocAllocator>(), 8192);
+    InitAllocator<ScratchAllocator>(&GetAllocator<MallocAllocator>(), 512 * 1024);
+
+    Core::ClassInfoUtils::Instance()->Initialize();
+
+    uint32_t maxRooms = 64, shardsCount = 1;
+    float seconds = 3.0f;
+    Network::HostInstance::HostSettings hostSettings;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (0 == strcmp(argv[i], "-rooms"))
+            maxRooms = std::max(1u, (uint32_t)strtoul(argv[i + 1], nullptr, 10));
+        else if (0 == strcmp(argv[i], "-players"))
+            playersPerRoom = std::max(1u, std::min((uint32_t)strtoul(argv[i + 1], nullptr, 10), kMaxBots));
+        else if (0 == strcmp(argv[i], "-seconds"))
+            seconds = (float)atof(argv[i + 1]);
+        else if (0 == strcmp(argv[i], "-shards"))
+            shardsCount = std::max(1u, (uint32_t)strtoul(argv[i + 1], nullptr, 10));
+        else if (0 == strcmp(argv[i], "-quickjoin"))
+            quickJoin = (atoi(argv[i + 1]) != 0);
+        else if (0 == strcmp(argv[i], "-compressor"))
+        {
+            if (!Network::HostInstance::FindCompressor(argv[i + 1], &hostSettings.compressor))
+                std::cout << "unknown compressor " << argv[i + 1] << std::endl;
+        }
+    }
+    maxRooms = std::min(maxRooms, kMaxBots / playersPerRoom);
+
+    // the server is the process' first instance, the bots share its log and time
+    serverInstance = new(serverInstanceBuffer) Network::ServerInstance();
+    Core::Log::Instance()->SetCallback([](int msgType, const char *msg)
+    {
+        if (verbose || msgType != Core::Log::Info)
+            std::cout << msg << std::endl;
+    });
+
+    serverInstance->SetHostSettings(hostSettings);
+    if (serverInstance->Initialize(kPort, shardsCount))
+    {
+        // every bot logs joining and starting, the server its stats, only the results are of interest
+        verbose = false;
+        for (uint32_t roomsCount = 1; ; roomsCount = std::min(roomsCount * 2, maxRooms))
+        {
+            bool added = AddRooms(roomsCount);
+            if (added)
+                Measure(roomsCount, seconds);
+
+            if (!added || roomsCount == maxRooms)
+                break;
+        }
+        verbose = true;
+    }
+
+    for (uint32_t i = 0; i < botsCount; ++i)
+    {
+        bots[i].client->RequestQuit();
+        Delete<MallocAllocator>(bots[i].client);
+    }
+
+    serverInstance->RequestStop();
+    serverInstance->~ServerInstance();
+    serverInstance = nullptr;
+
+    Core::RefCounted::GC.Collect();
+    Core::ClassInfoUtils::Destroy();
+
+    ShutdownMemory();
+
+    return 0;
+}
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 
 #include "Core/Memory/Memory.h"
 #include "Core/Memory/MallocAllocator.h"
@@ -6,6 +8,7 @@
 #include "Core/Memory/BlocksAllocator.h"
 #include "Core/Memory/ScratchAllocator.h"
 #include "Network/ServerInstance.h"
+#include "Core/IO/FileServer.h"
 #include "Managers/GetManager.h"
 
 using namespace Core::Memory;
@@ -13,6 +16,7 @@ using namespace Managers;
 
 Network::ServerInstance *serverInstance = nullptr;
 char serverInstanceBuffer[sizeof(Network::ServerInstance)];
+SmartPtr<Core::IO::FileServer> fileServer;
 
 void shutdown()
 {
@@ -20,6 +24,8 @@ void shutdown()
     serverInstance->~ServerInstance();
     serverInstance = nullptr;
 
+    fileServer.Reset();
+
     Core::ClassInfoUtils::Destroy();
 
     ShutdownMemory();
@@ -43,15 +49,55 @@ int main(int argc, char **argv) {
 
     atexit(shutdown);
 
-    if (serverInstance->Initialize(1234))
+    // THServer [-shards N] [-peers N] [-channels N] [-bwin bytes/s] [-bwout bytes/s] [-bwpeer bytes/s] [-compressor none|range|lz]
+    //          [-capture file] [-captureseconds S]
+    // more than one shard binds that many hosts to the port with SO_REUSEPORT, limits are per host;
+    // a capture records what the server receives for THReplay, for S seconds or until it stops
+    uint32_t shardsCount = 1;
+    const char *capturePath = nullptr;
+    float captureSeconds = .0f;
+    Network::HostInstance::HostSettings hostSettings;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        uint32_t value = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        if (0 == strcmp(argv[i], "-shards"))
+            shardsCount = value;
+        else if (0 == strcmp(argv[i], "-peers"))
+            hostSettings.peersCount = value;
+        else if (0 == strcmp(argv[i], "-channels"))
+            hostSettings.channelsCount = value;
+        else if (0 == strcmp(argv[i], "-bwin"))
+            hostSettings.incomingBandwidth = value;
+        else if (0 == strcmp(argv[i], "-bwout"))
+            hostSettings.outgoingBandwidth = value;
+        else if (0 == strcmp(argv[i], "-bwpeer"))
+            hostSettings.peerBandwidth = value;
+        else if (0 == strcmp(argv[i], "-capture"))
+            capturePath = argv[i + 1];
+        else if (0 == strcmp(argv[i], "-captureseconds"))
+            captureSeconds = (float)atof(argv[i + 1]);
+        else if (0 == strcmp(argv[i], "-compressor"))
+        {
+            if (!Network::HostInstance::FindCompressor(argv[i + 1], &hostSettings.compressor))
+                std::cout << "unknown compressor " << argv[i + 1] << std::endl;
+        }
+        else
+            std::cout << "unknown option " << argv[i] << std::endl;
+    }
+    serverInstance->SetHostSettings(hostSettings);
+
+    if (serverInstance->Initialize(1234, shardsCount))
     {
         std::cout << "server started" << std::endl;
 
-        while (true)
+        if (capturePath != nullptr)
         {
-            serverInstance->Tick();
-
-            Sleep(0);
+            fileServer = SmartPtr<Core::IO::FileServer>::MakeNew<LinearAllocator>();
+            serverInstance->StartCapture(capturePath, captureSeconds);
         }
+
+        // Tick blocks in ENet until there's network activity or a room step is due
+        while (true)
+            serverInstance->Tick();
     }
 }
@@ -0,0 +1,203 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+#include "Core/Memory/Memory.h"
+#include "Core/Memory/MallocAllocator.h"
+#include "Core/Memory/LinearAllocator.h"
+#include "Core/Memory/BlocksAllocator.h"
+#include "Core/Memory/ScratchAllocator.h"
+#include "Core/Collections/Array.h"
+#include "Network/ServerInstance.h"
+
+using namespace Core::Memory;
+
+// THPeersBench [-shards N] [-seconds S]
+// Connects plain ENet client peers to an in-process server, doubling them from 8 to 4096,
+// and reports what a non blocking ServerInstance::Tick costs at each step.
+// Every client peer sends a small unsequenced packet per server step, like inputs do.
+
+typedef std::chrono::steady_clock BenchClock;
+
+static const int kPort = 1235;
+static const uint32_t kPeersPerClientHost = 64; // spread source ports so SO_REUSEPORT shards get their share
+static const uint32_t kMaxClientHosts = 64;
+
+Network::ServerInstance *serverInstance = nullptr;
+char serverInstanceBuffer[sizeof(Network::ServerInstance)];
+
+ENetHost *clientHosts[kMaxClientHosts];
+uint32_t clientHostsCount = 0;
+uint32_t connectedPeers = 0;
+
+static void
+ServiceClients()
+{
+    ENetEvent event;
+    for (uint32_t i = 0; i < clientHostsCount; ++i)
+    {
+        while (enet_host_service(clientHosts[i], &event, 0) > 0)
+        {
+            do
+            {
+                switch (event.type)
+                {
+                case ENET_EVENT_TYPE_CONNECT:
+                    ++connectedPeers;
+                    break;
+                case ENET_EVENT_TYPE_DISCONNECT:
+                    --connectedPeers;
+                    break;
+                case ENET_EVENT_TYPE_RECEIVE:
+                    enet_packet_destroy(event.packet);
+                    break;
+                default:
+                    break;
+                }
+            } while (enet_host_check_events(clientHosts[i], &event) > 0);
+        }
+    }
+}
+
+static bool
+ConnectPeers(uint32_t peersCount)
+{
+    ENetAddress address;
+    enet_address_set_host(&address, "127.0.0.1");
+    address.port = kPort;
+
+    uint32_t channelsCount = serverInstance->GetHostSettings().channelsCount;
+    for (uint32_t i = connectedPeers; i < peersCount; ++i)
+    {
+        uint32_t hostIndex = i / kPeersPerClientHost;
+        if (hostIndex >= clientHostsCount)
+        {
+            ENetHost *clientHost = enet_host_create(nullptr, kPeersPerClientHost, channelsCount, 0, 0);
+            if (nullptr == clientHost)
+                return false;
+
+            clientHosts[clientHostsCount++] = clientHost;
+
+            if (!Network::HostInstance::SetCompressor(clientHost, serverInstance->GetHostSettings().compressor))
+                return false;
+        }
+
+        if (nullptr == enet_host_connect(clientHosts[hostIndex], &address, channelsCount, 0))
+            return false;
+    }
+
+    BenchClock::time_point timeout = BenchClock::now() + std::chrono::seconds(30);
+    while (connectedPeers < peersCount && BenchClock::now() < timeout)
+    {
+        ServiceClients();
+        serverInstance->Tick(false);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return connectedPeers >= peersCount;
+}
+
+static void
+Measure(uint32_t peersCount, float seconds)
+{
+    const std::chrono::microseconds sendInterval((int)(3 * Network::HostInstance::kFixedTimeStep * 1000000.0f));
+    const uint8_t payload[16] = { 0 }; // unknown FCC, the server drops it after parsing the header
+
+    BenchClock::time_point start = BenchClock::now(),
+                           end = start + std::chrono::microseconds((int)(seconds * 1000000.0f)),
+                           nextSend = start;
+
+    uint32_t ticks = 0;
+    double totalTime = 0.0, maxTime = 0.0;
+    while (BenchClock::now() < end)
+    {
+        if (BenchClock::now() >= nextSend)
+        {
+            for (uint32_t i = 0; i < clientHostsCount; ++i)
+                enet_host_broadcast(clientHosts[i], 0, enet_packet_create(payload, sizeof(payload), ENET_PACKET_FLAG_UNSEQUENCED));
+            nextSend += sendInterval;
+        }
+
+        ServiceClients();
+
+        BenchClock::time_point tickStart = BenchClock::now();
+        serverInstance->Tick(false);
+        double tickTime = std::chrono::duration<double, std::micro>(BenchClock::now() - tickStart).count();
+
+        totalTime += tickTime;
+        maxTime = tickTime > maxTime ? tickTime : maxTime;
+        ++ticks;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    double avgTime = totalTime / ticks;
+    Core::Log::Instance()->Write(Core::Log::Info, "%5u peers: %6u ticks, %9.2f us/tick avg, %9.2f us max, %7.4f us/peer",
+        peersCount, ticks, avgTime, maxTime, avgTime / peersCount);
+}
+
+int main(int argc, char **argv) {
+    InitializeMemory();
+
+    InitAllocator<MallocAllocator>();
+    InitAllocator<LinearAllocator>(&GetAllocator<MallocAllocator>(), 1 * 1024 * 1024, 16);
+    InitAllocator<BlocksAllocator>(&GetAllocator<MallocAllocator>(), 8192);
+    InitAllocator<ScratchAllocator>(&GetAllocator<MallocAllocator>(), 512 * 1024);
+
+    Core::ClassInfoUtils::Instance()->Initialize();
+
+    uint32_t shardsCount = 1;
+    float seconds = 3.0f;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (0 == strcmp(argv[i], "-shards"))
+            shardsCount = std::max(1u, (uint32_t)strtoul(argv[i + 1], nullptr, 10));
+        else if (0 == strcmp(argv[i], "-seconds"))
+            seconds = (float)atof(argv[i + 1]);
+    }
+
+    serverInstance = new(serverInstanceBuffer) Network::ServerInstance();
+    Core::Log::Instance()->SetCallback([](int msgType, const char *msg)
+    {
+        std::cout << msg << std::endl;
+    });
+
+    Network::HostInstance::HostSettings hostSettings;
+    hostSettings.peersCount = ENET_PROTOCOL_MAXIMUM_PEER_ID;
+    serverInstance->SetHostSettings(hostSettings);
+
+    if (serverInstance->Initialize(kPort, shardsCount))
+    {
+        uint32_t maxPeers = std::min(4096u, std::min(shardsCount * ENET_PROTOCOL_MAXIMUM_PEER_ID, kMaxClientHosts * kPeersPerClientHost));
+        for (uint32_t peersCount = 8; ; peersCount = std::min(peersCount * 2, maxPeers))
+        {
+            if (!ConnectPeers(peersCount))
+            {
+                std::cout << "only " << connectedPeers << " of " << peersCount << " peers connected" << std::endl;
+                break;
+            }
+
+            Measure(peersCount, seconds);
+
+            if (peersCount == maxPeers)
+                break;
+        }
+    }
+
+    for (uint32_t i = 0; i < clientHostsCount; ++i)
+        enet_host_destroy(clientHosts[i]);
+
+    serverInstance->RequestStop();
+    serverInstance->~ServerInstance();
+    serverInstance = nullptr;
+
+    Core::ClassInfoUtils::Destroy();
+
+    ShutdownMemory();
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+#include "Core/Memory/Memory.h"
+#include "Core/Memory/MallocAllocator.h"
+#include "Core/Memory/LinearAllocator.h"
+#include "Core/Memory/BlocksAllocator.h"
+#include "Core/Memory/ScratchAllocator.h"
+#include "Core/IO/FileServer.h"
+#include "Network/ServerInstance.h"
+#include "Network/PacketCapture.h"
+
+using namespace Core::Memory;
+
+// THReplay -capture file [-realtime 0|1] [-shards N] [-compressor none|range|lz]
+// Feeds a capture made with THServer -capture to a server, the same input for every build to compare.
+// The server runs on a virtual clock: it ticks when a captured event is due, as it did when it
+// received it, and whenever a room step is due in between. As fast as possible the clock jumps
+// from tick to tick, in real time it waits for the wall clock to catch up.
+// What the server sends goes to peers that aren't there, see ServerInstance::ReplayRecord.
+
+typedef std::chrono::steady_clock BenchClock;
+
+static const int kPort = 1238;
+static const uint32_t kStartTime = 1000; // ms of virtual time before the first record
+
+Network::ServerInstance *serverInstance = nullptr;
+char serverInstanceBuffer[sizeof(Network::ServerInstance)];
+
+bool realTime = false;
+BenchClock::time_point wallStart;
+
+uint32_t ticks = 0;
+double totalTime = 0.0, maxTime = 0.0;
+
+static void
+Tick(uint32_t now)
+{
+    Core::Time::TimeServer::Instance()->SetVirtualMilliseconds(now);
+    if (realTime)
+        std::this_thread::sleep_until(wallStart + std::chrono::milliseconds(now - kStartTime));
+
+    BenchClock::time_point tickStart = BenchClock::now();
+    serverInstance->Tick(false);
+    double tickTime = std::chrono::duration<double, std::micro>(BenchClock::now() - tickStart).count();
+
+    totalTime += tickTime;
+    maxTime = std::max(maxTime, tickTime);
+    ++ticks;
+}
+
+int main(int argc, char **argv) {
+    InitializeMemory();
+
+    InitAllocator<MallocAllocator>();
+    InitAllocator<LinearAllocator>(&GetAllocator<MallocAllocator>(), 1 * 1024 * 1024, 16);
+    InitAllocator<BlocksAllocator>(&GetAllocator<MallocAllocator>(), 8192);
+    InitAllocator<ScratchAllocator>(&GetAllocator<MallocAllocator>(), 512 * 1024);
+
+    Core::ClassInfoUtils::Instance()->Initialize();
+
+    const char *capturePath = nullptr;
+    uint32_t shardsCount = 1;
+    Network::HostInstance::HostSettings hostSettings;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (0 == strcmp(argv[i], "-capture"))
+            capturePath = argv[i + 1];
+        else if (0 == strcmp(argv[i], "-realtime"))
+            realTime = (atoi(argv[i + 1]) != 0);
+        else if (0 == strcmp(argv[i], "-shards"))
+            shardsCount = std::max(1u, (uint32_t)strtoul(argv[i + 1], nullptr, 10));
+        else if (0 == strcmp(argv[i], "-compressor"))
+        {
+            if (!Network::HostInstance::FindCompressor(argv[i + 1], &hostSettings.compressor))
+                std::cout << "unknown compressor " << argv[i + 1] << std::endl;
+        }
+        else
+            std::cout << "unknown option " << argv[i] << std::endl;
+    }
+
+    if (nullptr == capturePath)
+    {
+        std::cout << "usage: THReplay -capture file [-realtime 0|1] [-shards N] [-compressor none|range|lz]" << std::endl;
+        return 1;
+    }
+
+    serverInstance = new(serverInstanceBuffer) Network::ServerInstance();
+    Core::Log::Instance()->SetCallback([](int msgType, const char *msg)
+    {
+        std::cout << msg << std::endl;
+    });
+
+    // virtual from the start, ENet takes its time from the time server too
+    Core::Time::TimeServer::Instance()->SetVirtual(true, kStartTime);
+
+    {
+        auto fileServer = SmartPtr<Core::IO::FileServer>::MakeNew<LinearAllocator>();
+        Network::PacketCapture capture;
+
+        serverInstance->SetHostSettings(hostSettings);
+        if (capture.Load(capturePath) && serverInstance->Initialize(kPort, shardsCount))
+        {
+            wallStart = BenchClock::now();
+
+            uint32_t now = kStartTime;
+            Network::PacketCapture::Record record;
+            bool hasRecord = capture.Next(record);
+            while (hasRecord)
+            {
+                // room steps until the record is due
+                uint32_t recordTime = kStartTime + record.time;
+                while (now < recordTime)
+                {
+                    now = std::min(recordTime, now + std::max(1u, serverInstance->GetWaitTimeout()));
+                    Tick(now);
+                }
+
+                // every record due at once gets handled by the same tick
+                while (hasRecord && kStartTime + record.time <= now)
+                {
+                    serverInstance->ReplayRecord(record);
+                    hasRecord = capture.Next(record);
+                }
+                Tick(now);
+            }
+
+            double elapsed = std::chrono::duration<double>(BenchClock::now() - wallStart).count();
+            Core::Log::Instance()->Write(Core::Log::Info, "Replayed %u events, %.2f s in %.2f s: %u ticks, %.2f us/tick avg, %.2f us max, busy %.2f%%.",
+                capture.GetRecordsCount(), (now - kStartTime) * 0.001f, elapsed, ticks, ticks > 0 ? totalTime / ticks : 0.0, maxTime,
+                elapsed > 0.0 ? totalTime * 100.0 / (elapsed * 1000000.0) : 0.0);
+        }
+
+        serverInstance->RequestStop();
+        serverInstance->~ServerInstance();
+        serverInstance = nullptr;
+    }
+
+    Core::RefCounted::GC.Collect();
+    Core::ClassInfoUtils::Destroy();
+
+    ShutdownMemory();
+
+    return 0;
+}
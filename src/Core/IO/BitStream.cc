@@ -223,6 +223,54 @@ BitStream::WriteBits(const void *bits, BitSize numBits, bool swapNotAlignedBits)
     }
 }
 
+void
+BitStream::PatchBytes(BitSize bitPos, const void *bytes, size_t numBytes)
+{ // overwrites bytes already written, the stream size doesn't change
+    assert(bitPos + BytesToBits(numBytes) <= bitsUsed);
+
+    BitSize        dstBitsOffset = bitPos & 0x7;
+    unsigned char *dstByte       = data + (bitPos >> 3);
+
+    const unsigned char *srcByte = static_cast<const unsigned char*>(bytes);
+    for (size_t i = 0; i < numBytes; ++i, ++srcByte, ++dstByte) {
+        if (0 == dstBitsOffset) {
+            *dstByte = *srcByte;
+        } else {
+            dstByte[0] = (dstByte[0] & (0xff << (8 - dstBitsOffset))) | (*srcByte >> dstBitsOffset);
+            dstByte[1] = (dstByte[1] & (0xff >> dstBitsOffset)) | (*srcByte << (8 - dstBitsOffset));
+        }
+    }
+}
+
+void
+BitStream::WriteUInt(uint32_t value, uint32_t numBits)
+{ // most significant bit first, left aligned so that the last byte doesn't need swapping
+    assert(numBits > 0 && numBits <= 32);
+
+    uint32_t aligned = value << (32 - numBits);
+    unsigned char bytes[4] = {
+        (unsigned char)(aligned >> 24),
+        (unsigned char)(aligned >> 16),
+        (unsigned char)(aligned >> 8),
+        (unsigned char)aligned
+    };
+
+    this->ReserveBits(numBits + 8); // an unaligned write clears the byte after the last bit
+    this->WriteBits(bytes, numBits, false);
+}
+
+uint32_t
+BitStream::ReadUInt(uint32_t numBits) const
+{
+    assert(numBits > 0 && numBits <= 32);
+
+    unsigned char bytes[4] = { 0, 0, 0, 0 };
+    this->ReadBits(bytes, numBits, false);
+
+    uint32_t aligned = ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+    return aligned >> (32 - numBits); // drops the bits that followed in the last byte
+}
+
 void
 BitStream::ReadBits(void *bits, BitSize numBits, bool swapNotAlignedBits) const
 {
@@ -254,7 +302,8 @@ BitStream::ReadBits(void *bits, BitSize numBits, bool swapNotAlignedBits) const
             } else {
                 byteRead = (*srcByte << srcBitsOffset);
                 ++srcByte;
-                byteRead |= (*srcByte >> (8 - srcBitsOffset));
+                if (srcBitsOffset + bitsToRead > 8) // don't read past the data when the bits are all in this byte
+                    byteRead |= (*srcByte >> (8 - srcBitsOffset));
             }
 
             if (swapNotAlignedBits)
@@ -53,6 +53,7 @@ public:
     const void* GetData() const;
     const void* GetReadPos() const;
     size_t GetSize() const;
+    BitSize GetSizeInBits() const;
     size_t GetCapacity() const;
 
     void Fill(const void *_data, size_t dataLength, bool _copyData = true);
@@ -70,6 +71,11 @@ public:
     void Reserve(size_t size);
     void WriteBytes(const void *bytes, size_t numBytes);
     void ReadBytes(void *bytes, size_t numBytes);
+    void PatchBytes(BitSize bitPos, const void *bytes, size_t numBytes);
+
+    // the numBits lower bits of value, up to 32
+    void WriteUInt(uint32_t value, uint32_t numBits);
+    uint32_t ReadUInt(uint32_t numBits) const;
 
     template <typename T>
     BitStream& operator <<(const T &value);
@@ -120,6 +126,12 @@ BitStream::GetSize() const
     return BitsToBytes(bitsUsed);
 }
 
+inline BitStream::BitSize
+BitStream::GetSizeInBits() const
+{
+    return bitsUsed;
+}
+
 inline size_t
 BitStream::GetCapacity() const
 {
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace Core {
+    namespace Jobs {
+
+typedef void (*JobFunction)(void *data);
+typedef std::atomic<int32_t> JobCounter;
+
+struct Job
+{
+    JobFunction function;
+    void *data;
+    JobCounter *counter;
+    std::atomic<bool> queued;
+
+    Job()
+    : function(nullptr),
+      data(nullptr),
+      counter(nullptr),
+      queued(false)
+    { }
+};
+
+    } // namespace Jobs
+} // namespace Core
@@ -0,0 +1,199 @@
+#include "Core/Jobs/JobSystem.h"
+#include "Core/Collections/Array.h"
+#include "Core/Memory/MallocAllocator.h"
+
+using namespace Core::Memory;
+
+namespace Core {
+    namespace Jobs {
+
+DefineClassInfo(Core::Jobs::JobSystem, Core::RefCounted);
+
+thread_local uint32_t JobSystem::workerIndex = 0;
+
+JobSystem::Worker::Worker(uint32_t index)
+: queue(GetAllocator<MallocAllocator>(), kMaxJobsPerWorker),
+  nextJob(0),
+  seed(index * 2654435761u + 1),
+  thread(nullptr)
+{
+    jobs = static_cast<Job*>(GetAllocator<MallocAllocator>().Allocate(sizeof(Job) * kMaxJobsPerWorker, __alignof(Job)));
+    for (uint32_t i = 0; i < kMaxJobsPerWorker; ++i)
+        new(jobs + i) Job();
+}
+
+JobSystem::Worker::~Worker()
+{
+    assert(nullptr == thread);
+    GetAllocator<MallocAllocator>().Free(jobs);
+}
+
+JobSystem::JobSystem(uint32_t threadsCount)
+: workers(GetAllocator<MallocAllocator>(), threadsCount + 1),
+  running(true),
+  pendingJobs(0)
+{
+    // worker 0 is the thread that owns the job system, it executes jobs only while waiting
+    for (uint32_t i = 0; i <= threadsCount; ++i)
+        workers.PushBack(New<MallocAllocator, Worker>(i));
+
+    for (uint32_t i = 1; i <= threadsCount; ++i)
+        workers[i]->thread = New<MallocAllocator, std::thread>(&JobSystem::WorkerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+    running = false;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeCondition.notify_all();
+    }
+
+    for (auto it = workers.Begin(), end = workers.End(); it != end; ++it)
+    {
+        if ((*it)->thread != nullptr)
+        {
+            (*it)->thread->join();
+            Delete<MallocAllocator>((*it)->thread);
+            (*it)->thread = nullptr;
+        }
+
+        Delete<MallocAllocator>(*it);
+    }
+}
+
+Job*
+JobSystem::FindJob(uint32_t index)
+{
+    Job *job = workers[index]->queue.Pop();
+    if (job != nullptr)
+        return job;
+
+    uint32_t count = workers.Count();
+    if (count < 2)
+        return nullptr;
+
+    // xorshift to pick the first victim, then sweep all the others
+    uint32_t &seed = workers[index]->seed;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    uint32_t victim = seed % count;
+    for (uint32_t i = 0; i < count; ++i, victim = (victim + 1) % count)
+    {
+        if (victim == index)
+            continue;
+
+        job = workers[victim]->queue.Steal();
+        if (job != nullptr)
+            return job;
+    }
+
+    return nullptr;
+}
+
+void
+JobSystem::Execute(Job *job)
+{
+    pendingJobs.fetch_sub(1, std::memory_order_relaxed);
+
+    JobFunction function = job->function;
+    void *data = job->data;
+    JobCounter *counter = job->counter;
+
+    job->queued.store(false, std::memory_order_release);
+
+    function(data);
+
+    counter->fetch_sub(1, std::memory_order_release);
+}
+
+void
+JobSystem::WorkerLoop(uint32_t index)
+{
+    workerIndex = index;
+
+    while (running.load(std::memory_order_relaxed))
+    {
+        Job *job = this->FindJob(index);
+        if (job != nullptr)
+        {
+            this->Execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait(lock, [this]()
+        {
+            return pendingJobs.load(std::memory_order_relaxed) > 0 || !running.load(std::memory_order_relaxed);
+        });
+    }
+}
+
+uint32_t
+JobSystem::GetWorkersCount() const
+{
+    return workers.Count();
+}
+
+void
+JobSystem::Run(JobFunction function, void *data, JobCounter *counter)
+{
+    assert(workerIndex < workers.Count());
+    Worker *worker = workers[workerIndex];
+
+    counter->fetch_add(1, std::memory_order_relaxed);
+
+    Job *job = worker->jobs + (worker->nextJob & (kMaxJobsPerWorker - 1));
+    if (job->queued.load(std::memory_order_acquire))
+    { // every slot is still in flight, run inline
+        function(data);
+        counter->fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    ++worker->nextJob;
+
+    job->function = function;
+    job->data = data;
+    job->counter = counter;
+    job->queued.store(true, std::memory_order_relaxed);
+
+    pendingJobs.fetch_add(1, std::memory_order_relaxed);
+    if (!worker->queue.Push(job))
+    {
+        pendingJobs.fetch_sub(1, std::memory_order_relaxed);
+        job->queued.store(false, std::memory_order_relaxed);
+
+        function(data);
+        counter->fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    wakeCondition.notify_one();
+}
+
+void
+JobSystem::Wait(JobCounter *counter)
+{
+    while (counter->load(std::memory_order_acquire) > 0)
+    {
+        Job *job = this->FindJob(workerIndex);
+        if (job != nullptr)
+            this->Execute(job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+uint32_t
+JobSystem::GetDefaultThreadsCount()
+{
+    uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+    } // namespace Jobs
+} // namespace Core
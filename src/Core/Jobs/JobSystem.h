@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "Core/Singleton.h"
+#include "Core/Collections/Array_type.h"
+#include "Core/Jobs/Job.h"
+#include "Core/Jobs/WorkStealingQueue.h"
+
+namespace Core {
+    namespace Jobs {
+
+class JobSystem : public Singleton<JobSystem> {
+    DeclareClassInfo;
+public:
+    static const uint32_t kMaxJobsPerWorker = 4096;
+protected:
+    struct Worker
+    {
+        WorkStealingQueue queue;
+        Job *jobs;
+        uint32_t nextJob;
+        uint32_t seed;
+        std::thread *thread;
+
+        Worker(uint32_t index);
+        ~Worker();
+    };
+
+    static thread_local uint32_t workerIndex;
+
+    Collections::Array<Worker*> workers;
+
+    std::atomic<bool> running;
+    std::atomic<int32_t> pendingJobs;
+
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+
+    Job* FindJob(uint32_t index);
+    void Execute(Job *job);
+    void WorkerLoop(uint32_t index);
+public:
+    JobSystem(uint32_t threadsCount);
+    JobSystem(const JobSystem &other) = delete;
+    virtual ~JobSystem();
+
+    JobSystem& operator =(const JobSystem &other) = delete;
+
+    uint32_t GetWorkersCount() const;
+
+    void Run(JobFunction function, void *data, JobCounter *counter);
+    void Wait(JobCounter *counter);
+
+    static uint32_t GetDefaultThreadsCount();
+};
+
+    } // namespace Jobs
+} // namespace Core
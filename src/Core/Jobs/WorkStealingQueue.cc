@@ -0,0 +1,85 @@
+#include "Core/Jobs/WorkStealingQueue.h"
+#include "Core/Debug.h"
+#include "Core/Memory/Memory.h"
+#include "Core/Memory/Allocator.h"
+
+namespace Core {
+    namespace Jobs {
+
+WorkStealingQueue::WorkStealingQueue(Memory::Allocator &_allocator, uint32_t capacity)
+: allocator(&_allocator),
+  top(0),
+  bottom(0),
+  mask(capacity - 1)
+{
+    assert(capacity > 0 && 0 == (capacity & (capacity - 1)));
+
+    jobs = static_cast<std::atomic<Job*>*>(allocator->Allocate(sizeof(std::atomic<Job*>) * capacity, __alignof(std::atomic<Job*>)));
+    for (uint32_t i = 0; i < capacity; ++i)
+        new(jobs + i) std::atomic<Job*>(nullptr);
+}
+
+WorkStealingQueue::~WorkStealingQueue()
+{
+    allocator->Free(jobs);
+}
+
+bool
+WorkStealingQueue::Push(Job *job)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t > mask)
+        return false;
+
+    jobs[b & mask].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+
+    return true;
+}
+
+Job*
+WorkStealingQueue::Pop()
+{
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b)
+    { // empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job *job = jobs[b & mask].load(std::memory_order_relaxed);
+    if (t == b)
+    { // last job, race against thieves
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+Job*
+WorkStealingQueue::Steal()
+{
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+
+    if (t >= b)
+        return nullptr;
+
+    Job *job = jobs[t & mask].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+
+    return job;
+}
+
+    } // namespace Jobs
+} // namespace Core
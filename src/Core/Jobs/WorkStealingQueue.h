@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include "Core/Jobs/Job.h"
+
+namespace Core {
+    namespace Memory {
+
+class Allocator;
+
+    } // namespace Memory
+
+    namespace Jobs {
+
+// Bounded Chase-Lev deque: the owner thread pushes and pops at the bottom,
+// any other thread may steal from the top.
+class WorkStealingQueue {
+private:
+    Memory::Allocator *allocator;
+
+    std::atomic<int64_t> top;
+    std::atomic<int64_t> bottom;
+
+    std::atomic<Job*> *jobs;
+    int64_t mask;
+public:
+    WorkStealingQueue(Memory::Allocator &_allocator, uint32_t capacity);
+    WorkStealingQueue(const WorkStealingQueue &other) = delete;
+    ~WorkStealingQueue();
+
+    WorkStealingQueue& operator =(const WorkStealingQueue &other) = delete;
+
+    bool Push(Job *job);
+    Job* Pop();
+    Job* Steal();
+
+    bool IsEmpty() const;
+};
+
+inline bool
+WorkStealingQueue::IsEmpty() const
+{
+    return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+}
+
+    } // namespace Jobs
+} // namespace Core
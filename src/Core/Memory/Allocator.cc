@@ -12,6 +12,12 @@ Allocator::Allocator()
 Allocator::~Allocator()
 { }
 
+bool
+Allocator::IsScoped() const
+{
+    return false;
+}
+
 Allocator::Allocator(const Allocator &other)
 { }
 
@@ -24,6 +24,10 @@ public:
 
     virtual size_t GetAllocatedSize(void *pointer) = 0;
     virtual size_t GetTotalAllocated() = 0;
+
+    // Frees everything at once instead of one by one, ref counted objects in it are destroyed as
+    // soon as they're released rather than left to the garbage collector.
+    virtual bool IsScoped() const;
 protected:
     template <typename H>
     static H* GetPointerFromData(void *data)
@@ -0,0 +1,92 @@
+#include "Core/Memory/ArenaAllocator.h"
+#include "Core/Debug.h"
+
+namespace Core {
+    namespace Memory {
+
+DefineClassInfo(Core::Memory::ArenaAllocator, Core::Memory::Allocator);
+
+ArenaAllocator::ArenaAllocator(Allocator *allocator, size_t _chunkSize)
+: baseAllocator(allocator),
+  chunkSize(_chunkSize),
+  chunks(nullptr),
+  ptr(nullptr),
+  end(nullptr),
+  totalAllocated(0),
+  totalReserved(0)
+{ }
+
+ArenaAllocator::~ArenaAllocator()
+{
+    this->Reset();
+}
+
+void
+ArenaAllocator::AllocateChunk(size_t minSize)
+{ // larger requests get a chunk of their own
+    size_t size = sizeof(Chunk) + (minSize > chunkSize ? minSize : chunkSize);
+
+    Chunk *chunk = static_cast<Chunk*>(baseAllocator->Allocate(size, __alignof(Chunk)));
+    chunk->next = chunks;
+    chunk->size = size;
+    chunks = chunk;
+
+    ptr = (uint8_t*)(chunk + 1);
+    end = (uint8_t*)chunk + size;
+
+    totalReserved += size;
+}
+
+void*
+ArenaAllocator::Allocate(size_t size, size_t align)
+{
+    size_t ts = Allocator::GetAlignedSize(size, align);
+    if (nullptr == ptr || (size_t)(end - ptr) < ts)
+        this->AllocateChunk(ts);
+
+    void *p = ptr;
+    ptr += ts;
+    totalAllocated += ts;
+
+    return Allocator::GetDataFromPointer(p, align);
+}
+
+void
+ArenaAllocator::Free(void *pointer)
+{ }
+
+size_t
+ArenaAllocator::GetAllocatedSize(void *pointer)
+{
+    return 0;
+}
+
+size_t
+ArenaAllocator::GetTotalAllocated()
+{
+    return totalAllocated;
+}
+
+bool
+ArenaAllocator::IsScoped() const
+{
+    return true;
+}
+
+void
+ArenaAllocator::Reset()
+{
+    while (chunks != nullptr)
+    {
+        Chunk *next = chunks->next;
+        baseAllocator->Free(chunks);
+        chunks = next;
+    }
+
+    ptr = end = nullptr;
+    totalAllocated = 0;
+    totalReserved = 0;
+}
+
+    } // namespace Memory
+} // namespace Core
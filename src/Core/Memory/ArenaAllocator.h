@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Core/Memory/Memory.h"
+#include "Core/Memory/Allocator.h"
+
+namespace Core {
+    namespace Memory {
+
+// Bump allocates out of chunks taken from a base allocator, Free does nothing.
+// What was allocated goes all at once on Reset or destruction, one free per chunk,
+// so it suits things that live and die together. Not thread-safe.
+class ArenaAllocator : public Allocator {
+    DeclareClassInfo;
+private:
+    struct Chunk {
+        Chunk *next;
+        size_t size;
+    };
+
+    Allocator *baseAllocator;
+    size_t chunkSize;
+
+    Chunk *chunks; // the current one first
+    uint8_t *ptr;
+    uint8_t *end;
+
+    size_t totalAllocated;
+    size_t totalReserved;
+
+    void AllocateChunk(size_t minSize);
+public:
+    ArenaAllocator(Allocator *allocator, size_t _chunkSize);
+    virtual ~ArenaAllocator();
+
+    virtual void* Allocate(size_t size, size_t align);
+    virtual void Free(void *pointer);
+
+    virtual size_t GetAllocatedSize(void *pointer);
+    virtual size_t GetTotalAllocated();
+
+    virtual bool IsScoped() const;
+
+    // taken from the base allocator, what the arena costs
+    size_t GetTotalReserved() const;
+
+    void Reset();
+};
+
+inline size_t
+ArenaAllocator::GetTotalReserved() const
+{
+    return totalReserved;
+}
+
+    } // namespace Memory
+} // namespace Core
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include "Core/Memory/Memory.h"
 #include "Core/Memory/Allocator.h"
 
@@ -10,7 +11,7 @@ class MallocAllocator : public Allocator {
     DeclareClassInfo;
     DeclareAllocator(MallocAllocator);
 private:
-    size_t totalAllocated;
+    std::atomic<size_t> totalAllocated; // job workers allocate through here too
 public:
     MallocAllocator();
     virtual ~MallocAllocator();
@@ -41,9 +41,22 @@ template <typename T>
 inline void
 Pool<T>::CopyObjects(void *dest, void *src, uint32_t objectsCount)
 {
-    T *ptr0 = static_cast<T*>(dest), *ptr1 = static_cast<T*>(src);
-    for (uint32_t i = 0; i < objectsCount; ++i, ++ptr0, ++ptr1)
-        new(ptr0) T(*ptr1);
+    Pool<T>::CopyObjects(static_cast<T*>(dest), static_cast<T*>(src), objectsCount, std::is_copy_constructible<T>());
+}
+
+template <typename T>
+inline void
+Pool<T>::CopyObjects(T *dest, T *src, uint32_t objectsCount, std::true_type isCopyConstructible)
+{
+    for (uint32_t i = 0; i < objectsCount; ++i, ++dest, ++src)
+        new(dest) T(*src);
+}
+
+template <typename T>
+inline void
+Pool<T>::CopyObjects(T *dest, T *src, uint32_t objectsCount, std::false_type isCopyConstructible)
+{
+    assert(false);
 }
 
 template <typename T>
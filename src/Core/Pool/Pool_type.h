@@ -1,5 +1,6 @@
 #pragma once
 
+#include <type_traits>
 #include "Core/Pool/BasePool.h"
 
 template <typename T> class Handle;
@@ -12,6 +13,10 @@ class Pool : public BasePool {
 protected:
     virtual void CopyObjects(void *dest, void *src, uint32_t objectsCount);
     virtual void MoveObjects(void *dest, void *src, uint32_t objectsCount);
+
+    // objects that can only be moved make a pool that can't be copied nor cloned
+    static void CopyObjects(T *dest, T *src, uint32_t objectsCount, std::true_type isCopyConstructible);
+    static void CopyObjects(T *dest, T *src, uint32_t objectsCount, std::false_type isCopyConstructible);
 public:
     Pool(Memory::Allocator &allocator);
     Pool(const Pool<T> &other);
@@ -1,6 +1,7 @@
 #include "Core/RefCounted.h"
 #include "Core/Memory/Allocator.h"
 #include "Core/Collections/List.h"
+#include "Core/RefCountedPool.h"
 
 namespace Core {
 
@@ -10,6 +11,7 @@ GarbageCollector RefCounted::GC;
 
 RefCounted::RefCounted()
 : refCount(0),
+  pool(nullptr),
   allocator(nullptr)
 {
     GC.garbage.PushBack(this);
@@ -23,7 +25,7 @@ RefCounted::~RefCounted()
 void
 RefCounted::AddRef()
 {
-    if (0 == refCount)
+    if (0 == refCount && nullptr == pool)
         GC.garbage.Remove(this);
 
     ++refCount;
@@ -37,9 +39,20 @@ RefCounted::Release()
     --refCount;
 
     if (0 == refCount)
-        GC.garbage.PushBack(this);
+    {
+        if (pool != nullptr)
+            pool->Recycle(this);
+        else if (allocator != nullptr && allocator->IsScoped())
+            this->~RefCounted(); // the allocator takes the memory back all at once
+        else
+            GC.garbage.PushBack(this);
+    }
 }
 
+void
+RefCounted::OnRecycle()
+{ }
+
 unsigned long
 RefCounted::GetRefCount() const
 {
@@ -9,6 +9,7 @@ namespace Core {
     } // namespace Memory
 
 class GarbageCollector;
+class RefCountedPool;
 
 class RefCounted {
     DeclareRootClassInfo;
@@ -18,6 +19,8 @@ private:
 	Collections::ListNode<RefCounted> node;
 	
 	unsigned long refCount;
+
+	RefCountedPool *pool; // takes the instance back when unreferenced, instead of the garbage collector
 public:
 	Memory::Allocator *allocator;
 
@@ -30,7 +33,11 @@ public:
 protected:
     virtual ~RefCounted();
 
+    // the instance went back to its pool, drop what it shouldn't keep alive until it's reused
+    virtual void OnRecycle();
+
 	friend class GarbageCollector;
+	friend class RefCountedPool;
 };
 
 class GarbageCollector {
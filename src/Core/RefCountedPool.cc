@@ -0,0 +1,72 @@
+#include "Core/RefCountedPool.h"
+#include "Core/Collections/Array.h"
+#include "Core/Memory/MallocAllocator.h"
+
+namespace Core {
+
+RefCountedPool::RefCountedPool(const ClassInfo *_classInfo, Memory::Allocator *_allocator, uint32_t initialCount)
+: classInfo(_classInfo),
+  allocator(_allocator),
+  instances(Memory::GetAllocator<Memory::MallocAllocator>()),
+  freeInstances(Memory::GetAllocator<Memory::MallocAllocator>())
+{
+    assert(classInfo->IsDerivedFrom(&RefCounted::RTTI));
+
+    this->Grow(initialCount);
+}
+
+RefCountedPool::~RefCountedPool()
+{
+    // still referenced, they go to the garbage collector as usual; done first, instances holds the free ones too
+    for (auto it = instances.Begin(), end = instances.End(); it != end; ++it)
+    {
+        if ((*it)->refCount > 0)
+            (*it)->pool = nullptr;
+    }
+
+    for (auto it = freeInstances.Begin(), end = freeInstances.End(); it != end; ++it)
+    {
+        (*it)->pool = nullptr;
+        (*it)->~RefCounted();
+        allocator->Free(*it);
+    }
+}
+
+void
+RefCountedPool::Grow(uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        SmartPtr<RefCounted> instance = classInfo->Create(allocator);
+
+        // out of the garbage collector list for good, an unreferenced instance waits in freeInstances
+        instance->pool = this;
+        instances.PushBack(instance.Get());
+    } // Release hands it to Recycle
+}
+
+SmartPtr<RefCounted>
+RefCountedPool::Acquire()
+{
+    if (0 == freeInstances.Count())
+        this->Grow(instances.Count() > 0 ? instances.Count() : 1);
+
+    SmartPtr<RefCounted> instance;
+    instance.ptr = freeInstances.Back();
+    instance.ptr->AddRef();
+
+    freeInstances.PopBack();
+
+    return instance;
+}
+
+void
+RefCountedPool::Recycle(RefCounted *instance)
+{
+    assert(this == instance->pool && 0 == instance->refCount);
+
+    instance->OnRecycle();
+    freeInstances.PushBack(instance);
+}
+
+}; // namespace Core
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Core/SmartPtr.h"
+#include "Core/ClassInfo.h"
+#include "Core/Collections/Array_type.h"
+
+namespace Core {
+
+// Instances of one class, handed out again once unreferenced instead of going through the garbage
+// collector and their allocator. Only grows, when all of its instances are in use.
+// Not thread-safe, like the garbage collector.
+class RefCountedPool {
+protected:
+    const ClassInfo *classInfo;
+    Memory::Allocator *allocator;
+
+    Collections::Array<RefCounted*> instances;
+    Collections::Array<RefCounted*> freeInstances;
+
+    void Grow(uint32_t count);
+public:
+    RefCountedPool(const ClassInfo *_classInfo, Memory::Allocator *_allocator, uint32_t initialCount = 0);
+    RefCountedPool(const RefCountedPool &other) = delete;
+    ~RefCountedPool();
+
+    RefCountedPool& operator =(const RefCountedPool &other) = delete;
+
+    const ClassInfo* GetClassInfo() const;
+    uint32_t GetCount() const;
+    uint32_t GetFreeCount() const;
+
+    SmartPtr<RefCounted> Acquire();
+    void Recycle(RefCounted *instance);
+};
+
+inline const ClassInfo*
+RefCountedPool::GetClassInfo() const
+{
+    return classInfo;
+}
+
+inline uint32_t
+RefCountedPool::GetCount() const
+{
+    return instances.Count();
+}
+
+inline uint32_t
+RefCountedPool::GetFreeCount() const
+{
+    return freeInstances.Count();
+}
+
+}; // namespace Core
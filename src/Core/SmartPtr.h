@@ -43,10 +43,15 @@ public:
     template <typename A, typename U, typename ...Args>
     static SmartPtr<T> MakeNew(Args... params);
 
+    // from an allocator instance instead of a global one
+    template <typename ...Args>
+    static SmartPtr<T> MakeNewIn(Core::Memory::Allocator *a, Args... params);
+
     template <class U>
     static SmartPtr<T> CastFrom(const SmartPtr<U>& p);
 
     friend class Core::ClassInfo;
+    friend class Core::RefCountedPool;
 };
 
 template <class T>
@@ -234,6 +239,21 @@ SmartPtr<T>::MakeNew(Args... params)
     return sp;
 }
 
+template <class T>
+template <typename ...Args>
+SmartPtr<T>
+SmartPtr<T>::MakeNewIn(Core::Memory::Allocator *a, Args... params)
+{
+    Core::RefCounted *p = new(a->Allocate(sizeof(T), __alignof(T))) T(params...);
+    p->allocator = a;
+
+    SmartPtr<T> sp;
+    sp.ptr = static_cast<T*>(p);
+    sp.ptr->AddRef();
+
+    return sp;
+}
+
 template <class T>
 template <class U>
 SmartPtr<T>
@@ -9,12 +9,28 @@ namespace Core {
 
 DefineClassInfo(Core::Time::TimeServer, Core::RefCounted);
 
+const uint64_t TimeServer::kNanosecondsPerSecond;
+const uint64_t TimeServer::kNanosecondsPerMillisecond;
+
+#if !defined _WIN32 && !defined __APPLE__
+static uint64_t
+ReadMonotonicClock()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * TimeServer::kNanosecondsPerSecond + (uint64_t)ts.tv_nsec;
+}
+#endif
+
 TimeServer::TimeServer()
 : paused(false),
-  realTime(0.0f),
-  deltaTime(0.0f),
-  totalTime(0.0f),
-  totalPauseTime(0.0f),
+  realTime(0),
+  deltaTime(0),
+  totalTime(0),
+  totalPauseTime(0),
+  pauseStartTime(0),
+  virtualClock(false),
+  virtualTime(0),
   sources(GetAllocator<MallocAllocator>())
 {
 #if defined _WIN32
@@ -23,12 +39,35 @@ TimeServer::TimeServer()
 #elif defined __APPLE__
 	machAbsTimeStart = mach_absolute_time();
 	mach_timebase_info(&timebaseInfo);
+#else
+    clockStart = ReadMonotonicClock();
 #endif
 }
 
 TimeServer::~TimeServer()
 { }
 
+uint64_t
+TimeServer::ReadClock() const
+{
+    if (virtualClock)
+        return virtualTime;
+
+#if defined _WIN32
+    __int64 timeCounter;
+    QueryPerformanceCounter((LARGE_INTEGER*)&timeCounter);
+
+    // seconds and the rest apart, counter * 10^9 would overflow within hours
+    uint64_t ticks = (uint64_t)(timeCounter - timeStart);
+    return (ticks / timeFreq) * kNanosecondsPerSecond + ((ticks % timeFreq) * kNanosecondsPerSecond) / timeFreq;
+#elif defined __APPLE__
+    uint64_t machAbsTime = mach_absolute_time();
+    return ((machAbsTime - machAbsTimeStart) * timebaseInfo.numer) / timebaseInfo.denom;
+#else
+    return ReadMonotonicClock() - clockStart;
+#endif
+}
+
 void
 TimeServer::AddSource(const SmartPtr<TimeSource> &timeSource)
 {
@@ -47,25 +86,17 @@ TimeServer::RemoveSource(const SmartPtr<TimeSource> &timeSource)
 void
 TimeServer::Tick()
 {
-    float oldTotalTime = totalTime;
-
-#if defined _WIN32
-    QueryPerformanceCounter((LARGE_INTEGER*)&timeCounter);
-
-    realTime = ((timeCounter - timeStart) / (float)timeFreq);
-#elif defined __APPLE__
-    machAbsTime = mach_absolute_time();
-    uint64_t nanosec = ((machAbsTime - machAbsTimeStart) * timebaseInfo.numer) / timebaseInfo.denom;
+    uint64_t oldTotalTime = totalTime;
 
-    realTime = nanosec * 0.000000001f;
-#endif
+    realTime = this->ReadClock();
 
     totalTime = paused ? oldTotalTime : (realTime - totalPauseTime);
     deltaTime = totalTime - oldTotalTime;
 
+    float dt = ToSeconds(deltaTime);
     auto it = sources.Begin(), end = sources.End();
     for (; it != end; ++it)
-        (*it)->Update(deltaTime);
+        (*it)->Update(dt);
 }
 
 void
@@ -75,12 +106,7 @@ TimeServer::Pause()
         return;
 
     paused = true;
-
-#if defined _WIN32
-    QueryPerformanceCounter((LARGE_INTEGER*)&timePaused);
-#elif defined __APPLE__
-	machAbsTimePaused = mach_absolute_time();
-#endif
+    pauseStartTime = this->ReadClock();
 
     auto it = sources.Begin(), end = sources.End();
     for (; it != end; ++it)
@@ -94,42 +120,18 @@ TimeServer::Resume()
         return;
 
     paused = false;
-
-#if defined _WIN32
-	__int64 endTime;
-    QueryPerformanceCounter((LARGE_INTEGER*)&endTime);
-
-    totalPauseTime += ((endTime - timePaused) / (float)timeFreq);
-#elif defined __APPLE__
-	uint64_t endTime = mach_absolute_time();
-	uint64_t nanosec = ((endTime - machAbsTimePaused) * timebaseInfo.numer) / timebaseInfo.denom;
-	
-	totalPauseTime += (nanosec * 0.000000001f);
-#endif
+    totalPauseTime += this->ReadClock() - pauseStartTime;
 
     auto it = sources.Begin(), end = sources.End();
     for (; it != end; ++it)
         (*it)->Play();
 }
 
-uint32_t
-TimeServer::GetMilliseconds() const
-{
-#if defined _WIN32
-    QueryPerformanceCounter((LARGE_INTEGER*)&timeCounter);
-
-    return ((timeCounter - timeStart) * 1000 / timeFreq);
-#elif defined __APPLE__
-    uint64_t absTime = mach_absolute_time();
-    uint64_t nanosec = ((absTime - machAbsTimeStart) * timebaseInfo.numer) / timebaseInfo.denom;
-    return nanosec * 0.000001f;
-#endif
-}
-
-float
-TimeServer::GetSeconds() const
+void
+TimeServer::SetVirtual(bool _virtualClock, uint32_t milliseconds)
 {
-    return this->GetMilliseconds() * 0.001f;
+    virtualClock = _virtualClock;
+    virtualTime = milliseconds * kNanosecondsPerMillisecond;
 }
 
     }; // namespace Time
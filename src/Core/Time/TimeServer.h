@@ -10,6 +10,8 @@
 #   include <windows.h>
 #elif defined __APPLE__
 #   include <mach/mach_time.h>
+#else
+#   include <time.h>
 #endif
 
 namespace Core {
@@ -18,26 +20,36 @@ namespace Core {
 class TimeServer : public Singleton<TimeServer> {
     DeclareClassInfo;
 protected:
+    // nanoseconds since the time server started, exact for centuries of uptime
 	bool paused;
-	float realTime;
-    float deltaTime;
-    float totalTime;
-    float totalPauseTime;
+	uint64_t realTime;
+    uint64_t deltaTime;
+    uint64_t totalTime;
+    uint64_t totalPauseTime;
+    uint64_t pauseStartTime;
+
+    // a virtual clock only moves when told, replays run the server on one
+    bool virtualClock;
+    uint64_t virtualTime;
 
     Collections::Array<SmartPtr<TimeSource>> sources;
 
 #if defined _WIN32
     __int64 timeStart;
     __int64 timeFreq;
-    __int64 timeCounter;
-    __int64 timePaused;
 #elif defined __APPLE__
 	mach_timebase_info_data_t timebaseInfo;
 	uint64_t machAbsTimeStart;
-	uint64_t machAbsTime;
-	uint64_t machAbsTimePaused;
+#else
+    uint64_t clockStart;
 #endif
+
+    // now, from the platform's monotonic clock or the virtual one
+    uint64_t ReadClock() const;
 public:
+    static const uint64_t kNanosecondsPerSecond = 1000000000;
+    static const uint64_t kNanosecondsPerMillisecond = 1000000;
+
     TimeServer();
     virtual ~TimeServer();
 
@@ -48,13 +60,27 @@ public:
     void Pause();
     void Resume();
 
+    void SetVirtual(bool _virtualClock, uint32_t milliseconds = 0);
+    void SetVirtualMilliseconds(uint32_t milliseconds);
+    bool IsVirtual() const;
+
+    // the clock now, not as of the last Tick; milliseconds wrap after 49 days, as ENet expects
+    uint64_t GetNanoseconds() const;
     uint32_t GetMilliseconds() const;
-    float GetSeconds() const;
+    double GetSeconds() const;
 
     bool IsPaused() const;
+
+    // as of the last Tick, in float seconds for short spans and exact in nanoseconds
     float GetRealTime() const;
     float GetDeltaTime() const;
     float GetTime() const;
+    uint64_t GetRealNanoseconds() const;
+    uint64_t GetDeltaNanoseconds() const;
+    uint64_t GetTimeNanoseconds() const;
+
+    static float ToSeconds(uint64_t nanoseconds);
+    static constexpr uint64_t FromSeconds(float seconds);
 };
 
 inline bool
@@ -63,23 +89,83 @@ TimeServer::IsPaused() const
     return paused;
 }
 
+inline void
+TimeServer::SetVirtualMilliseconds(uint32_t milliseconds)
+{
+    virtualTime = milliseconds * kNanosecondsPerMillisecond;
+}
+
+inline bool
+TimeServer::IsVirtual() const
+{
+    return virtualClock;
+}
+
+inline uint64_t
+TimeServer::GetNanoseconds() const
+{
+    return this->ReadClock();
+}
+
+inline uint32_t
+TimeServer::GetMilliseconds() const
+{
+    return (uint32_t)(this->ReadClock() / kNanosecondsPerMillisecond);
+}
+
+inline double
+TimeServer::GetSeconds() const
+{
+    return this->ReadClock() * 0.000000001;
+}
+
 inline float
 TimeServer::GetRealTime() const
 {
-    return realTime;
+    return ToSeconds(realTime);
 }
 
 inline float
 TimeServer::GetDeltaTime() const
 {
-    return deltaTime;
+    return ToSeconds(deltaTime);
 }
 
 inline float
 TimeServer::GetTime() const
+{
+    return ToSeconds(totalTime);
+}
+
+inline uint64_t
+TimeServer::GetRealNanoseconds() const
+{
+    return realTime;
+}
+
+inline uint64_t
+TimeServer::GetDeltaNanoseconds() const
+{
+    return deltaTime;
+}
+
+inline uint64_t
+TimeServer::GetTimeNanoseconds() const
 {
     return totalTime;
 }
 
+inline float
+TimeServer::ToSeconds(uint64_t nanoseconds)
+{
+    return (float)(nanoseconds * 0.000000001);
+}
+
+inline constexpr uint64_t
+TimeServer::FromSeconds(float seconds)
+{
+    return (uint64_t)((double)seconds * kNanosecondsPerSecond + 0.5);
+}
+
     }; // namespace Time
 }; // namespace Core
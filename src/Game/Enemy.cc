@@ -1,5 +1,6 @@
 #include "Game/Enemy.h"
 #include "Core/Collections/Array.h"
+#include "Game/StateHistory.h"
 #include "Core/Collections/Queue.h"
 #include "Core/Memory/Memory.h"
 #include "Core/Memory/MallocAllocator.h"
@@ -15,46 +16,60 @@ namespace Game {
 
 DefineClassInfo(Game::Enemy, Core::RefCounted);
 
-Enemy::Enemy(Type _type, const NetData &data)
+const float Enemy::kSpeed = 2.5f;
+const uint8_t Enemy::kWaypointsCount;
+const uint8_t Enemy::kMaxHealth;
+
+Enemy::Enemy(Type _type, const NetData &data, Allocator *statesAllocator)
 : type(_type),
-  states(GetAllocator<BlocksAllocator>(), _type == SimulatedOnServer ? 32 : 10),
-  waypoints(GetAllocator<MallocAllocator>(), 3),
-  waypointIndex(0)
+  states(*statesAllocator, 32) // steps, clones get a state every few of them
 {
-    states.PushBack(State(.0f, data.p0x, data.p0y));
-
-    waypoints.PushBack(Vector2(data.p0x, data.p0y));
-    waypoints.PushBack(Vector2(data.p1x, data.p1y));
-    waypoints.PushBack(Vector2(data.p2x, data.p2y));
+    states.Push(State(0, data.p0x, data.p0y, kMaxHealth));
 }
 
 Enemy::~Enemy()
 { }
 
 void
-Enemy::Step(State &state)
+Enemy::Step(uint32_t count, Vector2 *positions, uint8_t *waypointIndices, const Vector2 *waypoints, const uint8_t *healths)
 {
-    Vector2 newPos(state.px, state.py);
-    Vector2 currWaypoint = waypoints[waypointIndex];
-    Vector2 toWaypoint = currWaypoint - newPos;
-
-    float sqDist = toWaypoint.GetSqrMagnitude();
-    if (sqDist <= 1.0f)
+    const float stepLength = kSpeed * Network::HostInstance::kFixedTimeStep;
+    for (uint32_t i = 0; i < count; ++i, waypoints += kWaypointsCount)
     {
-        waypointIndex = (waypointIndex + 1) % waypoints.Count();
+        if (0 == healths[i])
+            continue;
 
-        currWaypoint = waypoints[waypointIndex];
-        toWaypoint = currWaypoint - newPos;
-        sqDist = toWaypoint.GetSqrMagnitude();
-    }
+        Vector2 &position = positions[i];
+        uint8_t &waypointIndex = waypointIndices[i];
+
+        // plain floats, Vector2 operators aren't inlined
+        float dx = waypoints[waypointIndex].x - position.x,
+              dy = waypoints[waypointIndex].y - position.y,
+              sqDist = dx * dx + dy * dy;
+        if (sqDist <= 1.0f)
+        {
+            waypointIndex = (waypointIndex + 1) % kWaypointsCount;
+
+            dx = waypoints[waypointIndex].x - position.x;
+            dy = waypoints[waypointIndex].y - position.y;
+            sqDist = dx * dx + dy * dy;
+        }
 
-    toWaypoint /= sqrtf(sqDist);
-    newPos += (toWaypoint * 2.5f * Network::HostInstance::kFixedTimeStep);
+        if (sqDist <= SqrEpsilon)
+            continue; // on the waypoint, no direction to go
 
-    state.px = newPos.x;
-    state.py = newPos.y;
+        float scale = stepLength / sqrtf(sqDist);
+        position.x += dx * scale;
+        position.y += dy * scale;
+    }
+}
 
-    ++state.step;
+void
+Enemy::GetWaypoints(const NetData &data, Vector2 *waypoints)
+{
+    waypoints[0] = Vector2(data.p0x, data.p0y);
+    waypoints[1] = Vector2(data.p1x, data.p1y);
+    waypoints[2] = Vector2(data.p2x, data.p2y);
 }
 
 void
@@ -62,85 +77,62 @@ Enemy::SendEnemyState(const SmartPtr<EnemyState> &enemyState)
 {
     assert(type != SimulatedOnServer);
 
-    int i = 0, c = states.Count();
-    for (; i < c; ++i)
-    {
-        if (states[i].step < enemyState->step)
-            break;
-    }
-
-    if (c == states.Capacity())
-    {
-        if (i == c)
-            return;
-        else
-            states.PopBack();
-    }
-
-    states.Insert(i, State(enemyState->step, enemyState->x, enemyState->y));
+    states.Push(State(enemyState->step, enemyState->x, enemyState->y, enemyState->health));
 }
 
 void
-Enemy::Update(uint32_t step)
+Enemy::PushState(const State &state)
 {
-    if (Cloned == type)
-        return;
-
-    State newState = states[0];
-
-    while (newState.step < step)
-    {
-        this->Step(newState);
-
-        if (states.Capacity() == states.Count())
-            states.PopBack();
+    assert(SimulatedOnServer == type);
 
-        states.Insert(0, newState);
-    }
+    states.Push(state);
 }
 
 void
 Enemy::GetCurrentPosition(float *x, float *y)
 {
-    auto &s = states.Front();
+    auto &s = states.Newest();
     *x = s.px;
     *y = s.py;
 }
 
+uint8_t
+Enemy::GetCurrentHealth() const
+{
+    return states.Newest().health;
+}
+
 void
 Enemy::GetPositionAtTime(float t, float *x, float *y)
 {
-    int last = states.Count() - 1, i = last;
+    uint32_t s = t > 0.0f ? floorf(t / Network::HostInstance::kFixedTimeStep) : 0;
 
-    uint32_t s = floorf(t / Network::HostInstance::kFixedTimeStep);
+    // the newest state before s and the oldest from s on
+    const State *before = s > 0 ? states.FindAtOrBefore(s - 1) : nullptr,
+                *after  = states.FindAtOrAfter(s);
 
-    while (i >= 0 && states[i].step < s)
-        --i;
-
-    if (-1 == i)
+    if (nullptr == after)
     { // too new
-        *x = states[0].px;
-        *y = states[0].py;
+        auto &s0 = states.Newest();
+        *x = s0.px;
+        *y = s0.py;
+    }
+    else if (nullptr == before)
+    { // too old
+        *x = after->px;
+        *y = after->py;
     }
     else
     {
-        if (i == last)
-        { // too old
-            *x = states[i].px;
-            *y = states[i].py;
-        }
-        else
-        {
-            auto &s0 = states[i + 1],
-                 &s1 = states[i];
+        auto &s0 = *before,
+             &s1 = *after;
 
-            float t0 = s0.step * Network::HostInstance::kFixedTimeStep,
-                  t1 = s1.step * Network::HostInstance::kFixedTimeStep,
-                  u  = (t - t0) / (t1 - t0);
+        float t0 = s0.step * Network::HostInstance::kFixedTimeStep,
+              t1 = s1.step * Network::HostInstance::kFixedTimeStep,
+              u  = (t - t0) / (t1 - t0);
 
-            *x = Math::Lerp(s0.px, s1.px, u);
-            *y = Math::Lerp(s0.py, s1.py, u);
-        }
+        *x = Math::Lerp(s0.px, s1.px, u);
+        *y = Math::Lerp(s0.py, s1.py, u);
     }
 }
 
@@ -2,6 +2,7 @@
 
 #include "Core/RefCounted.h"
 #include "Core/Collections/Array_type.h"
+#include "Game/StateHistory_type.h"
 #include "Math/Vector2.h"
 #include "Network/Messages/EnemyState.h"
 
@@ -23,12 +24,13 @@ public:
     {
         uint32_t step;
         float px, py;
+        uint8_t health;
 
         State()
         { }
 
-        State(uint32_t _step, float _px, float _py)
-        : step(_step), px(_px), py(_py)
+        State(uint32_t _step, float _px, float _py, uint8_t _health)
+        : step(_step), px(_px), py(_py), health(_health)
         { }
     };
 
@@ -38,28 +40,34 @@ public:
         float p1x, p1y;
         float p2x, p2y;
     };
+
+    static const float kSpeed;
+    static const uint8_t kWaypointsCount = 3;
+    static const uint8_t kMaxHealth = 3; // hits it takes, fits Serializable::kHealthBits
 protected:
     Type type;
-    Array<State> states;
-    Array<Math::Vector2> waypoints;
-    uint8_t waypointIndex;
-
-    void Step(State &state);
+    StateHistory<State> states;
 public:
-    Enemy(Type _type, const NetData &data);
+    Enemy(Type _type, const NetData &data, Core::Memory::Allocator *statesAllocator);
     Enemy(const Enemy &other) = delete;
     virtual ~Enemy();
 
     Enemy& operator =(const Enemy &other) = delete;
 
     void SendEnemyState(const SmartPtr<EnemyState> &enemyState);
-
-    void Update(uint32_t step);
+    // server only, the state the level stepped this enemy to
+    void PushState(const State &state);
 
     Type GetType() const;
 
     void GetCurrentPosition(float *x, float *y);
+    uint8_t GetCurrentHealth() const;
     void GetPositionAtTime(float t, float *x, float *y);
+
+    // Steps count enemies by one, walking their waypoints loops, all arrays by enemy id and
+    // kWaypointsCount waypoints each. Dead ones stay where they fell.
+    static void Step(uint32_t count, Math::Vector2 *positions, uint8_t *waypointIndices, const Math::Vector2 *waypoints, const uint8_t *healths);
+    static void GetWaypoints(const NetData &data, Math::Vector2 *waypoints);
 };
 
 inline Enemy::Type
@@ -5,6 +5,9 @@
 #include "Core/Collections/Array.h"
 #include "Math/Math.h"
 #include "Math/Vector2.h"
+#include "Network/HostInstance.h"
+#include "Network/Messages/PlayerState.h"
+#include "Network/Messages/EnemyState.h"
 
 using namespace Core::Memory;
 using namespace Math;
@@ -13,9 +16,47 @@ namespace Game {
 
 DefineClassInfo(Game::Level, Core::RefCounted);
 
+const float Level::kGridCellSize = 4.0f;
+const float Level::kInterestEnterRadius = 40.0f;
+const float Level::kInterestLeaveRadius = 48.0f;
+const float Level::kViewDelay = 0.2f;
+
 Level::Level()
-: players(GetAllocator<MallocAllocator>()),
-  enemies(GetAllocator<MallocAllocator>())
+: entitiesAllocator(&GetAllocator<BlocksAllocator>()),
+  players(GetAllocator<MallocAllocator>()),
+  enemies(GetAllocator<MallocAllocator>()),
+  simStep(0),
+  simulatesEnemies(false),
+  enemiesStep(0),
+  enemyPositions(GetAllocator<MallocAllocator>()),
+  enemyWaypointIndices(GetAllocator<MallocAllocator>()),
+  enemyHealths(GetAllocator<MallocAllocator>()),
+  enemyWaypoints(GetAllocator<MallocAllocator>()),
+  playersGrid(GetAllocator<MallocAllocator>(), kGridCellSize),
+  enemiesGrid(GetAllocator<MallocAllocator>(), kGridCellSize),
+  candidates(GetAllocator<MallocAllocator>()),
+  attacks(GetAllocator<MallocAllocator>()),
+  rewoundEnemies(GetAllocator<MallocAllocator>()),
+  rewoundSteps(GetAllocator<MallocAllocator>())
+{ }
+
+Level::Level(Allocator *allocator)
+: entitiesAllocator(allocator),
+  players(*allocator),
+  enemies(*allocator),
+  simStep(0),
+  simulatesEnemies(false),
+  enemiesStep(0),
+  enemyPositions(*allocator),
+  enemyWaypointIndices(*allocator),
+  enemyHealths(*allocator),
+  enemyWaypoints(*allocator),
+  playersGrid(*allocator, kGridCellSize),
+  enemiesGrid(*allocator, kGridCellSize),
+  candidates(*allocator),
+  attacks(*allocator),
+  rewoundEnemies(*allocator),
+  rewoundSteps(*allocator)
 { }
 
 Level::~Level()
@@ -27,17 +68,22 @@ Level::Init(const SmartPtr<Network::GameRoomData> &roomData)
     uint8_t id = 0, count = roomData->playersData.Count();
     players.Reserve(count);
     for (; id < count; ++id)
-        players.PushBack(SmartPtr<Player>::MakeNew<BlocksAllocator>(
+        players.PushBack(SmartPtr<Player>::MakeNewIn(entitiesAllocator,
             Player::SimulatedOnServer,
-            roomData->playersData[id]));
+            roomData->playersData[id],
+            entitiesAllocator));
 
     id = 0;
     count = roomData->enemiesData.Count();
     enemies.Reserve(count);
     for (; id < count; ++id)
-        enemies.PushBack(SmartPtr<Enemy>::MakeNew<BlocksAllocator>(
+        enemies.PushBack(SmartPtr<Enemy>::MakeNewIn(entitiesAllocator,
             Enemy::SimulatedOnServer,
-            roomData->enemiesData[id]));
+            roomData->enemiesData[id],
+            entitiesAllocator));
+
+    simulatesEnemies = true;
+    this->InitEntities(roomData);
 }
 
 void
@@ -46,57 +92,298 @@ Level::Init(const SmartPtr<Network::GameRoomData> &roomData, uint8_t clientPlaye
     uint8_t id = 0, count = roomData->playersData.Count();
     players.Reserve(count);
     for (; id < count; ++id)
-        players.PushBack(SmartPtr<Player>::MakeNew<BlocksAllocator>(
+        players.PushBack(SmartPtr<Player>::MakeNewIn(entitiesAllocator,
             id == clientPlayerId ? Player::SimulatedLagless : Player::Cloned,
-            roomData->playersData[id]));
+            roomData->playersData[id],
+            entitiesAllocator));
 
     id = 0;
     count = roomData->enemiesData.Count();
     enemies.Reserve(count);
     for (; id < count; ++id)
-        enemies.PushBack(SmartPtr<Enemy>::MakeNew<BlocksAllocator>(
+        enemies.PushBack(SmartPtr<Enemy>::MakeNewIn(entitiesAllocator,
             Enemy::Cloned,
-            roomData->enemiesData[id]));
+            roomData->enemiesData[id],
+            entitiesAllocator));
+
+    simulatesEnemies = false;
+    this->InitEntities(roomData);
+}
+
+void
+Level::InitEntities(const SmartPtr<Network::GameRoomData> &roomData)
+{
+    uint32_t count = enemies.Count();
+    enemiesStep = 0;
+    enemyPositions.Resize(count);
+    enemyWaypointIndices.Resize(count);
+    enemyHealths.Resize(count);
+    enemyWaypoints.Resize(count * Enemy::kWaypointsCount);
+    for (uint32_t id = 0; id < count; ++id)
+    {
+        Enemy::GetWaypoints(roomData->enemiesData[id], enemyWaypoints.Begin() + id * Enemy::kWaypointsCount);
+        enemyPositions[id] = enemyWaypoints[id * Enemy::kWaypointsCount];
+        enemyWaypointIndices[id] = 0;
+        enemyHealths[id] = Enemy::kMaxHealth;
+    }
+
+    rewoundEnemies.Resize(count);
+    rewoundSteps.Resize(count);
+
+    this->PlacePlayers();
+    this->PlaceEnemies();
+}
+
+void
+Level::PlacePlayers()
+{
+    uint32_t count = players.Count();
+    playersGrid.Reset(count);
+    for (uint32_t id = 0; id < count; ++id)
+    {
+        Vector2 p;
+        players[id]->GetCurrentPosition(&p.x, &p.y);
+        playersGrid.Place(id, p);
+    }
+}
+
+void
+Level::PlaceEnemies()
+{
+    uint32_t count = enemies.Count();
+    enemiesGrid.Reset(count);
+    for (uint32_t id = 0; id < count; ++id)
+    {
+        if (enemyHealths[id] > 0)
+            enemiesGrid.Place(id, enemyPositions[id]);
+    }
 }
 
 void
 Level::DeletePlayer(uint8_t playerId)
 {
     players.RemoveAt(playerId);
+
+    // the ids after playerId moved down by one
+    this->PlacePlayers();
 }
 
 void
-Level::Update(uint32_t simStep)
+Level::Update(uint32_t _simStep)
 {
-    auto plyIt = players.Begin(), plyEnd = players.End();
-    for (; plyIt != plyEnd; ++plyIt)
-        (*plyIt)->Update(simStep);
+    simStep = _simStep;
 
-    auto enmIt = enemies.Begin(), enmEnd = enemies.End();
-    for (; enmIt != enmEnd; ++enmIt)
-        (*enmIt)->Update(simStep);
+    this->UpdatePlayers();
+    this->UpdateEnemies();
+    this->ResolveAttacks();
 }
 
 void
-Level::GetEnemiesInRange(float t, float x, float y, float angle, float radius, float coneAngle, Array<SmartPtr<Enemy>> &list) const
+Level::UpdatePlayers()
 {
-    Vector2 p(x, y);
-    auto enmIt = enemies.Begin(), enmEnd = enemies.End();
-    for (; enmIt != enmEnd; ++enmIt)
+    uint32_t count = players.Count();
+    for (uint32_t id = 0; id < count; ++id)
     {
-        Vector2 enmPos;
-        (*enmIt)->GetPositionAtTime(t, &p.x, &p.y);
+        auto &player = players[id];
+        player->Update(simStep);
+
+        Vector2 p;
+        player->GetCurrentPosition(&p.x, &p.y);
+        playersGrid.Place(id, p);
 
-        Vector2 toEnemy = enmPos - p;
-        float dist = toEnemy.Normalize();
+        if (!simulatesEnemies)
+            continue;
+
+        auto &hits = player->GetAttackHits();
+        for (uint32_t i = 0; i < hits.Count(); ++i)
+            this->EnqueueAttack(player, hits[i], Player::kAttackHit);
+    }
+}
 
-        if (dist <= radius)
+void
+Level::UpdateEnemies()
+{
+    uint32_t count = enemies.Count();
+    if (simulatesEnemies)
+    {
+        while (enemiesStep < simStep)
+        {
+            Enemy::Step(count, enemyPositions.Begin(), enemyWaypointIndices.Begin(), enemyWaypoints.Begin(), enemyHealths.Begin());
+            ++enemiesStep;
+
+            for (uint32_t id = 0; id < count; ++id)
+                enemies[id]->PushState(Enemy::State(enemiesStep, enemyPositions[id].x, enemyPositions[id].y, enemyHealths[id]));
+        }
+    }
+    else
+    { // clones, the server states are the current ones
+        for (uint32_t id = 0; id < count; ++id)
         {
-            float aDiff = atan2f(toEnemy.y, toEnemy.x) - angle;
-            if (std::abs(aDiff) <= coneAngle)
-                list.PushBack((*enmIt));
+            enemies[id]->GetCurrentPosition(&enemyPositions[id].x, &enemyPositions[id].y);
+            enemyHealths[id] = enemies[id]->GetCurrentHealth();
         }
     }
+
+    for (uint32_t id = 0; id < count; ++id)
+    {
+        if (enemyHealths[id] > 0)
+            enemiesGrid.Place(id, enemyPositions[id]);
+        else
+            enemiesGrid.Remove(id);
+    }
+}
+
+void
+Level::FillPlayerState(uint8_t playerId, const SmartPtr<PlayerState> &playerState) const
+{
+    auto &s = players[playerId]->GetNewestState();
+    playerState->step = s.step;
+    playerState->x = s.position.x;
+    playerState->y = s.position.y;
+    playerState->dx = s.direction.x;
+    playerState->dy = s.direction.y;
+    playerState->actionState = s.actionState;
+    playerState->actionStep = s.actionStep;
+}
+
+void
+Level::FillEnemyState(uint8_t enemyId, const SmartPtr<EnemyState> &enemyState) const
+{
+    enemyState->step = enemiesStep;
+    enemyState->x = enemyPositions[enemyId].x;
+    enemyState->y = enemyPositions[enemyId].y;
+    enemyState->health = enemyHealths[enemyId];
+}
+
+float
+Level::GetEnemiesDrift(float t) const
+{
+    float dt = simStep * Network::HostInstance::kFixedTimeStep - t;
+    return dt > 0.0f ? dt * Enemy::kSpeed : 0.0f;
+}
+
+void
+Level::EnqueueAttack(const SmartPtr<Player> &attacker, uint32_t step, const Player::AttackHitData &hitData)
+{
+    // late inputs bring older steps, they go in from the back
+    uint32_t i = attacks.Count();
+    while (i > 0 && attacks[i - 1].step > step)
+        --i;
+
+    PendingAttack attack = { attacker, step, hitData };
+    attacks.Insert(i, attack);
+}
+
+void
+Level::ResolveAttacks()
+{
+    if (0 == attacks.Count())
+        return;
+
+    for (uint32_t i = 0, c = rewoundSteps.Count(); i < c; ++i)
+        rewoundSteps[i] = SpatialGrid::kNone;
+
+    auto it = attacks.Begin(), end = attacks.End();
+    for (; it != end; ++it)
+    {
+        // the attacker isn't delayed, it's where its own inputs took it
+        Vector2 p, dir;
+        Player::ActionState actionState;
+        float actionTime;
+        it->attacker->GetStateAtTime(it->step * Network::HostInstance::kFixedTimeStep, &p.x, &p.y, &dir.x, &dir.y, &actionState, &actionTime);
+
+        const Player::AttackHitData &hitData = it->hitData;
+        Vector2 side(-dir.y, dir.x);
+        p += dir * hitData.offset.x + side * hitData.offset.y;
+        dir = dir * cosf(hitData.angle) + side * sinf(hitData.angle);
+
+        // only the enemies that could have been in range at t, rewound once per step
+        float t = std::min(it->step, simStep) * Network::HostInstance::kFixedTimeStep - kViewDelay;
+        candidates.Clear();
+        enemiesGrid.QueryRadius(p, hitData.radius + this->GetEnemiesDrift(t), candidates);
+
+        float cosConeAngle = cosf(hitData.coneAngle);
+        auto enmIt = candidates.Begin(), enmEnd = candidates.End();
+        for (; enmIt != enmEnd; ++enmIt)
+        {
+            uint32_t enemyId = *enmIt;
+            if (0 == enemyHealths[enemyId])
+                continue; // killed by an earlier attack
+
+            Vector2 &enmPos = rewoundEnemies[enemyId];
+            if (rewoundSteps[enemyId] != it->step)
+            {
+                enemies[enemyId]->GetPositionAtTime(t, &enmPos.x, &enmPos.y);
+                rewoundSteps[enemyId] = it->step;
+            }
+
+            if (SpatialGrid::IsInCone(p, dir, hitData.radius, cosConeAngle, enmPos) && 0 == --enemyHealths[enemyId])
+                enemiesGrid.Remove(enemyId);
+        }
+    }
+
+    attacks.Clear();
+}
+
+void
+Level::UpdateRelevance(const Vector2 &p, const Vector2 &entityPos, uint8_t *flag, float *priority)
+{
+    float dist = (entityPos - p).GetMagnitude();
+    *flag = (dist <= (*flag ? kInterestLeaveRadius : kInterestEnterRadius));
+    if (*flag)
+        *priority += 2.0f - dist / kInterestLeaveRadius;
+    else
+        *priority = 0.0f;
+}
+
+void
+Level::UpdateInterest(uint8_t playerId, uint8_t *interest, float *priorities) const
+{
+    Vector2 p;
+    players[playerId]->GetCurrentPosition(&p.x, &p.y);
+
+    uint8_t *flag = interest;
+    float *priority = priorities;
+    auto plyIt = players.Begin(), plyEnd = players.End();
+    for (; plyIt != plyEnd; ++plyIt, ++flag, ++priority)
+    {
+        if (plyIt - players.Begin() == playerId)
+        {
+            *flag = 1;
+            *priority += 2.0f;
+            continue;
+        }
+
+        Vector2 plyPos;
+        (*plyIt)->GetCurrentPosition(&plyPos.x, &plyPos.y);
+        UpdateRelevance(p, plyPos, flag, priority);
+    }
+
+    auto enmIt = enemyPositions.Begin(), enmEnd = enemyPositions.End();
+    for (; enmIt != enmEnd; ++enmIt, ++flag, ++priority)
+        UpdateRelevance(p, *enmIt, flag, priority);
+}
+
+void
+Level::GetEnemiesInRange(float t, float x, float y, float angle, float radius, float coneAngle, Array<SmartPtr<Enemy>> &list) const
+{
+    Vector2 p(x, y), dir(cosf(angle), sinf(angle));
+
+    candidates.Clear();
+    enemiesGrid.QueryRadius(p, radius + this->GetEnemiesDrift(t), candidates);
+
+    float cosConeAngle = cosf(coneAngle);
+    auto idIt = candidates.Begin(), idEnd = candidates.End();
+    for (; idIt != idEnd; ++idIt)
+    {
+        auto &enemy = enemies[*idIt];
+
+        Vector2 enmPos;
+        enemy->GetPositionAtTime(t, &enmPos.x, &enmPos.y);
+
+        if (SpatialGrid::IsInCone(p, dir, radius, cosConeAngle, enmPos))
+            list.PushBack(enemy);
+    }
 }
 
 } // namespace Game
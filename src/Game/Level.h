@@ -3,6 +3,7 @@
 #include "Core/RefCounted.h"
 #include "Core/Collections/Array_type.h"
 #include "Network/GameRoomData.h"
+#include "Game/SpatialGrid.h"
 
 namespace Game {
 
@@ -11,11 +12,58 @@ using Core::Collections::Array;
 class Level : public Core::RefCounted {
     DeclareClassInfo;
 protected:
+    struct PendingAttack
+    {
+        SmartPtr<Player> attacker;
+        uint32_t step;
+        Player::AttackHitData hitData;
+    };
+
+    Core::Memory::Allocator *entitiesAllocator; // players, enemies and their states
     uint8_t userPlayerId;
     Array<SmartPtr<Player>> players;
     Array<SmartPtr<Enemy>> enemies;
+    uint32_t simStep;
+
+    // The current state of the enemies, one array per field, by id, the server steps them all
+    // together. Players step through their own inputs and keep their states.
+    bool simulatesEnemies;
+    uint32_t enemiesStep;
+    Array<Math::Vector2> enemyPositions;
+    Array<uint8_t> enemyWaypointIndices;
+    Array<uint8_t> enemyHealths; // dead at 0, off the grid
+    Array<Math::Vector2> enemyWaypoints; // Enemy::kWaypointsCount each
+
+    // current positions, by player and enemy id
+    SpatialGrid playersGrid;
+    SpatialGrid enemiesGrid;
+    mutable Array<uint32_t> candidates; // grid queries scratch
+
+    Array<PendingAttack> attacks; // ordered by step
+    Array<Math::Vector2> rewoundEnemies; // enemies positions as seen at rewoundSteps
+    Array<uint32_t> rewoundSteps;
+
+    void InitEntities(const SmartPtr<Network::GameRoomData> &roomData);
+    void PlacePlayers();
+    void PlaceEnemies();
+    void UpdatePlayers();
+    void UpdateEnemies();
+    void ResolveAttacks();
+
+    // the farthest an enemy went from where it was at time t
+    float GetEnemiesDrift(float t) const;
+
+    static void UpdateRelevance(const Math::Vector2 &p, const Math::Vector2 &entityPos, uint8_t *flag, float *priority);
 public:
+    static const float kGridCellSize;
+    static const float kInterestEnterRadius;
+    static const float kInterestLeaveRadius;
+    // how far in the past clients show the entities they don't simulate
+    static const float kViewDelay;
+
     Level();
+    // everything the level allocates comes from allocator
+    explicit Level(Core::Memory::Allocator *allocator);
     Level(const Level &other) = delete;
     virtual ~Level();
 
@@ -34,9 +82,25 @@ public:
     const SmartPtr<Enemy>* EnemiesBegin() const;
     const SmartPtr<Enemy>* EnemiesEnd() const;
 
+    void FillPlayerState(uint8_t playerId, const SmartPtr<PlayerState> &playerState) const;
+    void FillEnemyState(uint8_t enemyId, const SmartPtr<EnemyState> &enemyState) const;
+
+    // Which players and enemies matter to playerId, one flag each, players then enemies.
+    // An entity enters within kInterestEnterRadius and leaves past kInterestLeaveRadius,
+    // so one walking along the border doesn't keep coming and going.
+    // Priorities of the entities in grow every call, closer ones faster, until they're sent.
+    void UpdateInterest(uint8_t playerId, uint8_t *interest, float *priorities) const;
+
     void GetEnemiesInRange(float t, float x, float y, float angle, float radius, float coneAngle, Array<SmartPtr<Enemy>> &list) const;
 
-    void EnqueueAttack(const SmartPtr<Player> &attacker, uint32_t simStep, const Player::AttackHitData &hitData);
+    // The attack lands at step, the attacker saw the enemies kViewDelay earlier and that's where
+    // they get hit. Attacks queue up and are resolved together at the end of the Update, every hit
+    // takes one health off the enemy. Only the server resolves them, clients get the healths.
+    void EnqueueAttack(const SmartPtr<Player> &attacker, uint32_t step, const Player::AttackHitData &hitData);
+
+    // radius, cone and nearest queries on the entities current positions
+    const SpatialGrid& GetPlayersGrid() const;
+    const SpatialGrid& GetEnemiesGrid() const;
 };
 
 inline const SmartPtr<Player>&
@@ -75,4 +139,16 @@ Level::EnemiesEnd() const
     return enemies.End();
 }
 
+inline const SpatialGrid&
+Level::GetPlayersGrid() const
+{
+    return playersGrid;
+}
+
+inline const SpatialGrid&
+Level::GetEnemiesGrid() const
+{
+    return enemiesGrid;
+}
+
 } // namespace Game
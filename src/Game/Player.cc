@@ -1,5 +1,6 @@
 #include "Game/Player.h"
 #include "Core/Collections/Array.h"
+#include "Game/StateHistory.h"
 #include "Core/Memory/Memory.h"
 #include "Core/Memory/MallocAllocator.h"
 #include "Core/Memory/BlocksAllocator.h"
@@ -30,15 +31,19 @@ Player::State::State(const SmartPtr<PlayerState> &playerState)
 
 DefineClassInfo(Game::Player, Core::RefCounted);
 
-Player::Player(Type _type, const NetData &data)
+const Player::AttackHitData Player::kAttackHit = { 15, 1, Vector2(1.0f, 0.0f), 0.0f, 2.5f, Math::Pi * 0.25f };
+
+Player::Player(Type _type, const NetData &data, Allocator *statesAllocator)
 : type(_type),
-  inputs(GetAllocator<BlocksAllocator>(), 32),
-  states(GetAllocator<BlocksAllocator>(), 32),
+  inputs(*statesAllocator, 32),
+  states(*statesAllocator, 32),
+  attackHits(*statesAllocator, 2),
   offsetX(0.0f),
   offsetY(0.0f),
-  hasChanged(false)
+  hasChanged(false),
+  correctionsCount(0)
 {
-    states.PushBack(State(0, data.startX, data.startY));
+    states.Push(State(0, data.startX, data.startY));
 }
 
 Player::~Player()
@@ -114,10 +119,8 @@ Player::Step(State &state, const Input &input)
         float speed = Math::Lerp(10.0f, 0.0f, attackStep / 30.0f);
         state.position += state.direction * speed * Network::HostInstance::kFixedTimeStep;
 
-        if (15 == attackStep)
-        {
-
-        }
+        if (attackStep >= kAttackHit.step && attackStep < kAttackHit.step + kAttackHit.stepsCount)
+            attackHits.PushBack(input.step + 1);
 
         if (attackStep >= 30)
         {
@@ -134,16 +137,32 @@ Player::Step(State &state, const Input &input)
 
 void
 Player::SendPlayerInput(const SmartPtr<PlayerInputs> &playerInputs)
+{
+    this->SendPlayerInput(Input(playerInputs));
+}
+
+void
+Player::SendPlayerInput(const Input &input)
 {
     assert(type != Cloned);
 
+    // redundant copies of inputs the server already stepped past
+    if (SimulatedOnServer == type && input.step < states.Newest().step)
+        return;
+
     int i = 0, c = inputs.Count();
     for (; i < c; ++i)
     {
-        if (inputs[i].step < playerInputs->step)
+        if (inputs[i].step < input.step)
             break;
     }
 
+    if (i > 0 && inputs[i - 1].step == input.step)
+    { // a redundant copy, or the input changed again within the step
+        inputs[i - 1] = input;
+        return;
+    }
+
     if (c == inputs.Capacity())
     {
         if (i == c)
@@ -152,7 +171,7 @@ Player::SendPlayerInput(const SmartPtr<PlayerInputs> &playerInputs)
             inputs.PopBack();
     }
 
-    inputs.Insert(i, Input(playerInputs));
+    inputs.Insert(i, input);
 }
 
 void
@@ -160,41 +179,29 @@ Player::SendPlayerState(const SmartPtr<PlayerState> &playerState)
 {
     assert(type != SimulatedOnServer);
 
-    int i = 0, c = states.Count();
-    for (; i < c; ++i)
-    {
-        if (states[i].step <= playerState->step)
-            break;
-    }
-
     if (Cloned == type)
     {
-        if (c == states.Capacity())
-        {
-            if (i == c)
-                return;
-            else
-                states.PopBack();
-        }
-
-        states.Insert(i, State(playerState));
+        states.Push(State(playerState));
     }
     else // simulated on client, lagless
     {
-        State s = states[i];
-        states.RemoveRange(i, c - i); // remove older states
-
-        if (0 == i)
+        if (states.Newest().step <= playerState->step)
         { // newer state
-            //Core::Log::Instance()->Write(Core::Log::Info, "Recv newer player state %f,%f@%u (client: %f,%f@%u)", playerState->x, playerState->y, playerState->step, s.position.x, s.position.y, s.step);
+            //Core::Log::Instance()->Write(Core::Log::Info, "Recv newer player state %f,%f@%u", playerState->x, playerState->y, playerState->step);
 
-            states.PushBack(State(playerState));
+            states.Clear();
+            states.Push(State(playerState));
 
             // no lerp, just snap
             offsetX = offsetY = 0.0f;
         }
         else
         { // check old states for errors
+            const State *predicted = states.FindAtOrBefore(playerState->step);
+            if (nullptr == predicted)
+                return; // older than the predictions kept
+
+            State s = *predicted;
             Vector2 serverPos = Vector2(playerState->x, playerState->y);
             Vector2 clientPos = s.position;
 
@@ -204,8 +211,10 @@ Player::SendPlayerState(const SmartPtr<PlayerState> &playerState)
 
             if (sqDist > 0.0025f)//0.01f)
             {
+                ++correctionsCount;
+
                 // take current position
-                s = states[0];
+                s = states.Newest();
                 float x = s.position.x + offsetX;
                 float y = s.position.y + offsetY;
 
@@ -214,14 +223,14 @@ Player::SendPlayerState(const SmartPtr<PlayerState> &playerState)
                          newStateStep  = s.step;
 
                 states.Clear();
-                states.PushBack(State(playerState));
+                states.Push(State(playerState));
 
                 type = SimulatedOnServer;
                 this->Update(newStateStep);
                 type = SimulatedLagless;
 
                 // refresh lerp offsets
-                s = states[0];
+                s = states.Newest();
                 offsetX = x - s.position.x;
                 offsetY = y - s.position.y;
             }
@@ -236,7 +245,8 @@ Player::Update(uint32_t step)
         return;
 
     hasChanged = false;
-    State newState = states[0];
+    attackHits.Clear();
+    State newState = states.Newest();
     uint32_t prevStateStep = newState.step;
 
     // process new inputs
@@ -253,11 +263,7 @@ Player::Update(uint32_t step)
 
             if (newState.step > prevStateStep)
             {
-                if (states.Capacity() == states.Count())
-                    states.PopBack();
-
-                states.Insert(0, newState);
-
+                states.Push(newState);
                 hasChanged = true;
             }
         }
@@ -273,10 +279,7 @@ Player::Update(uint32_t step)
 
             if (newState.step > prevStateStep)
             {
-                if (states.Capacity() == states.Count())
-                    states.PopBack();
-
-                states.Insert(0, newState);
+                states.Push(newState);
 
                 hasChanged = true;
                 prevStateStep = newState.step;
@@ -294,10 +297,16 @@ Player::Update(uint32_t step)
     }
 }
 
+const Player::State&
+Player::GetNewestState() const
+{
+    return states.Newest();
+}
+
 void
 Player::GetCurrentPosition(float *x, float *y) const
 {
-    auto &s = states.Front();
+    auto &s = states.Newest();
     if (SimulatedLagless == type)
     {
         *x = s.position.x + offsetX;
@@ -313,7 +322,7 @@ Player::GetCurrentPosition(float *x, float *y) const
 void
 Player::GetCurrentDirection(float *dx, float *dy) const
 {
-    auto &s = states.Front();
+    auto &s = states.Newest();
     *dx = s.direction.x;
     *dy = s.direction.y;
 }
@@ -321,7 +330,7 @@ Player::GetCurrentDirection(float *dx, float *dy) const
 void
 Player::GetCurrentState(ActionState *state, float *time) const
 {
-    auto &s = states.Front();
+    auto &s = states.Newest();
     *state = s.actionState;
     *time = (s.step - s.actionStep) * Network::HostInstance::kFixedTimeStep;
 }
@@ -329,16 +338,15 @@ Player::GetCurrentState(ActionState *state, float *time) const
 void
 Player::GetStateAtTime(float t, float *x, float *y, float *dx, float *dy, ActionState *state, float *time) const
 {
-    int last = states.Count() - 1, i = last;
-
-    uint32_t s = floorf(t / Network::HostInstance::kFixedTimeStep);
+    uint32_t s = t > 0.0f ? floorf(t / Network::HostInstance::kFixedTimeStep) : 0;
 
-    while (i >= 0 && states[i].step < s)
-        --i;
+    // the newest state before s and the oldest from s on
+    const State *before = s > 0 ? states.FindAtOrBefore(s - 1) : nullptr,
+                *after  = states.FindAtOrAfter(s);
 
-    if (-1 == i) // too new
+    if (nullptr == after) // too new
     {
-        auto &s0 = states[0];
+        auto &s0 = states.Newest();
 
         *x     = s0.position.x;
         *y     = s0.position.y;
@@ -347,9 +355,9 @@ Player::GetStateAtTime(float t, float *x, float *y, float *dx, float *dy, Action
         *state = s0.actionState;
         *time  = (s0.step - s0.actionStep) * Network::HostInstance::kFixedTimeStep; // ToDo: fix?
     }
-    else if (last == i) // too old
+    else if (nullptr == before) // too old
     {
-        auto &s1 = states[last];
+        auto &s1 = *after;
 
         *x     = s1.position.x;
         *y     = s1.position.y;
@@ -360,8 +368,8 @@ Player::GetStateAtTime(float t, float *x, float *y, float *dx, float *dy, Action
     }
     else
     {
-        auto &s0 = states[i + 1],
-             &s1 = states[i];
+        auto &s0 = *before,
+             &s1 = *after;
 
         float t0 = s0.step * Network::HostInstance::kFixedTimeStep,
               t1 = s1.step * Network::HostInstance::kFixedTimeStep,
@@ -380,17 +388,4 @@ Player::GetStateAtTime(float t, float *x, float *y, float *dx, float *dy, Action
     }
 }
 
-void
-Player::FillPlayerState(const SmartPtr<PlayerState> &playerState)
-{
-    auto &s = states.Front();
-    playerState->step = s.step;
-    playerState->x = s.position.x;
-    playerState->y = s.position.y;
-    playerState->dx = s.direction.x;
-    playerState->dy = s.direction.y;
-    playerState->actionState = s.actionState;
-    playerState->actionStep = s.actionStep;
-}
-
 } // namespace Game
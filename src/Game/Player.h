@@ -3,6 +3,7 @@
 #include "Core/RefCounted.h"
 #include "Core/SmartPtr.h"
 #include "Core/Collections/Array_type.h"
+#include "Game/StateHistory_type.h"
 #include "Math/Math.h"
 #include "Math/Vector2.h"
 
@@ -80,7 +81,7 @@ public:
     {
         uint32_t step;
         uint32_t stepsCount;
-        Vector2 offset;
+        Math::Vector2 offset; // from the attacker, x along its direction
         float angle;
         float radius;
         float coneAngle;
@@ -98,38 +99,45 @@ public:
         float startX, startY;
         // ToDo: other data
     };
+
+    static const AttackHitData kAttackHit;
 protected:
     Type type;
     Array<Input> inputs;
-    Array<State> states;
+    StateHistory<State> states;
+    Array<uint32_t> attackHits; // steps stepped by the last Update where kAttackHit lands
 
     void RemoveOlderInputs(uint32_t step);
     void Step(State &state, const Input &input);
 
     float offsetX, offsetY;
     bool hasChanged;
+    uint32_t correctionsCount;
 public:
-    Player(Type _type, const NetData &data);
+    Player(Type _type, const NetData &data, Core::Memory::Allocator *statesAllocator);
     Player(const Player &other) = delete;
     virtual ~Player();
 
     Player& operator =(const Player &other) = delete;
 
     void SendPlayerInput(const SmartPtr<PlayerInputs> &playerInputs);
+    void SendPlayerInput(const Input &input); // replaces the one of the same step, if any
     void SendPlayerState(const SmartPtr<PlayerState> &playerState);
 
     void Update(uint32_t step);
 
     Type GetType() const;
     bool HasChanged() const;
+    const Array<uint32_t>& GetAttackHits() const;
+    // lagless only, server states that didn't match the prediction and made it replay the inputs
+    uint32_t GetCorrectionsCount() const;
 
+    const State& GetNewestState() const;
     void GetCurrentPosition(float *x, float *y) const;
     void GetCurrentDirection(float *dx, float *dy) const;
     void GetCurrentState(ActionState *state, float *time) const;
 
     void GetStateAtTime(float t, float *x, float *y, float *dx, float *dy, ActionState *state, float *time) const;
-
-    void FillPlayerState(const SmartPtr<PlayerState> &playerState);
 };
 
 inline Player::Type
@@ -144,4 +152,16 @@ Player::HasChanged() const
     return hasChanged;
 }
 
+inline const Array<uint32_t>&
+Player::GetAttackHits() const
+{
+    return attackHits;
+}
+
+inline uint32_t
+Player::GetCorrectionsCount() const
+{
+    return correctionsCount;
+}
+
 } // namespace Game
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include "Game/SpatialGrid.h"
+#include "Core/Collections/Array.h"
+#include "Math/Math.h"
+
+using namespace Core::Memory;
+using namespace Math;
+
+namespace Game {
+
+const uint32_t SpatialGrid::kNone;
+
+SpatialGrid::SpatialGrid(Allocator &allocator, float _cellSize)
+: cellSize(_cellSize),
+  invCellSize(1.0f / _cellSize),
+  entries(allocator),
+  heads(allocator)
+{ }
+
+SpatialGrid::~SpatialGrid()
+{ }
+
+void
+SpatialGrid::Reset(uint32_t count)
+{
+    // twice as many buckets as entities, most cells get a bucket of their own
+    uint32_t bucketsCount = 64;
+    while (bucketsCount < count * 2)
+        bucketsCount <<= 1;
+
+    heads.Resize(bucketsCount);
+    for (uint32_t i = 0; i < bucketsCount; ++i)
+        heads[i] = kNone;
+
+    entries.Resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+        entries[i].bucket = kNone;
+}
+
+void
+SpatialGrid::Link(uint32_t id)
+{
+    Entry &entry = entries[id];
+    entry.bucket = this->Bucket(entry.cx, entry.cy);
+    entry.prev = kNone;
+    entry.next = heads[entry.bucket];
+    if (entry.next != kNone)
+        entries[entry.next].prev = id;
+    heads[entry.bucket] = id;
+}
+
+void
+SpatialGrid::Unlink(uint32_t id)
+{
+    Entry &entry = entries[id];
+    if (kNone == entry.prev)
+        heads[entry.bucket] = entry.next;
+    else
+        entries[entry.prev].next = entry.next;
+    if (entry.next != kNone)
+        entries[entry.next].prev = entry.prev;
+
+    entry.bucket = kNone;
+}
+
+void
+SpatialGrid::Place(uint32_t id, const Vector2 &p)
+{
+    Entry &entry = entries[id];
+    entry.position = p;
+
+    int32_t cx = this->Cell(p.x), cy = this->Cell(p.y);
+    if (entry.bucket != kNone)
+    {
+        if (cx == entry.cx && cy == entry.cy)
+            return;
+
+        this->Unlink(id);
+    }
+
+    entry.cx = cx;
+    entry.cy = cy;
+    this->Link(id);
+}
+
+void
+SpatialGrid::Remove(uint32_t id)
+{
+    if (entries[id].bucket != kNone)
+        this->Unlink(id);
+}
+
+const Vector2&
+SpatialGrid::GetPosition(uint32_t id) const
+{
+    return entries[id].position;
+}
+
+void
+SpatialGrid::Gather(const Vector2 &p, float radius, Array<uint32_t> &ids) const
+{
+    float sqRadius = radius * radius;
+
+    int32_t minX = this->Cell(p.x - radius), maxX = this->Cell(p.x + radius),
+            minY = this->Cell(p.y - radius), maxY = this->Cell(p.y + radius);
+
+    uint64_t cellsCount = (uint64_t)(maxX - minX + 1) * (maxY - minY + 1);
+    if (cellsCount > entries.Count())
+    { // a wide query, cheaper to look at everyone
+        for (uint32_t id = 0, c = entries.Count(); id < c; ++id)
+        {
+            const Entry &entry = entries[id];
+            if (entry.bucket != kNone && (entry.position - p).GetSqrMagnitude() <= sqRadius)
+                ids.PushBack(id);
+        }
+        return;
+    }
+
+    for (int32_t cy = minY; cy <= maxY; ++cy)
+    {
+        for (int32_t cx = minX; cx <= maxX; ++cx)
+        {
+            uint32_t id = heads[this->Bucket(cx, cy)];
+            while (id != kNone)
+            {
+                const Entry &entry = entries[id];
+                // other cells may share the bucket
+                if (entry.cx == cx && entry.cy == cy && (entry.position - p).GetSqrMagnitude() <= sqRadius)
+                    ids.PushBack(id);
+
+                id = entry.next;
+            }
+        }
+    }
+}
+
+void
+SpatialGrid::QueryRadius(const Vector2 &p, float radius, Array<uint32_t> &ids) const
+{
+    this->Gather(p, radius, ids);
+}
+
+void
+SpatialGrid::QueryCone(const Vector2 &p, const Vector2 &dir, float radius, float coneAngle, Array<uint32_t> &ids) const
+{
+    uint32_t first = ids.Count();
+    this->Gather(p, radius, ids);
+
+    float cosConeAngle = cosf(coneAngle);
+    uint32_t last = first;
+    for (uint32_t i = first, c = ids.Count(); i < c; ++i)
+    {
+        if (IsInCone(p, dir, radius, cosConeAngle, entries[ids[i]].position))
+            ids[last++] = ids[i];
+    }
+    ids.Resize(last);
+}
+
+void
+SpatialGrid::QueryNearest(const Vector2 &p, uint32_t k, float maxRadius, Array<uint32_t> &ids) const
+{
+    if (0 == k)
+        return;
+
+    // the k closest are within any radius that holds k of them, widen until one does
+    uint32_t first = ids.Count();
+    float radius = std::min(cellSize, maxRadius);
+    for (;;)
+    {
+        this->Gather(p, radius, ids);
+        if (ids.Count() - first >= k || radius >= maxRadius)
+            break;
+
+        ids.Resize(first);
+        radius = std::min(radius * 2.0f, maxRadius);
+    }
+
+    // partial selection sort, k is small
+    uint32_t c = ids.Count(), last = std::min(first + k, c);
+    for (uint32_t i = first; i < last; ++i)
+    {
+        uint32_t closest = i;
+        float closestSqDist = (entries[ids[i]].position - p).GetSqrMagnitude();
+        for (uint32_t j = i + 1; j < c; ++j)
+        {
+            float sqDist = (entries[ids[j]].position - p).GetSqrMagnitude();
+            if (sqDist < closestSqDist)
+            {
+                closest = j;
+                closestSqDist = sqDist;
+            }
+        }
+
+        uint32_t id = ids[closest];
+        ids[closest] = ids[i];
+        ids[i] = id;
+    }
+    ids.Resize(last);
+}
+
+} // namespace Game
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include "Core/Collections/Array_type.h"
+#include "Math/Vector2.h"
+
+namespace Core {
+    namespace Memory {
+        class Allocator;
+    }
+}
+
+namespace Game {
+
+using Core::Collections::Array;
+
+// Entities by id on a uniform grid of square cells, the cells hashed to a fixed number of buckets.
+// Every bucket is a list linked through the entries, so an entity moving to another cell leaves
+// and joins in O(1), and queries only walk the buckets of the cells they overlap.
+class SpatialGrid {
+public:
+    static const uint32_t kNone = 0xffffffff;
+protected:
+    struct Entry
+    {
+        Math::Vector2 position;
+        int32_t cx, cy;
+        uint32_t bucket; // kNone if not placed
+        uint32_t prev, next;
+    };
+
+    float cellSize, invCellSize;
+    Array<Entry> entries;
+    Array<uint32_t> heads;
+
+    uint32_t Bucket(int32_t cx, int32_t cy) const;
+    int32_t Cell(float v) const;
+
+    void Link(uint32_t id);
+    void Unlink(uint32_t id);
+    // appends the ids within radius of p
+    void Gather(const Math::Vector2 &p, float radius, Array<uint32_t> &ids) const;
+public:
+    SpatialGrid(Core::Memory::Allocator &allocator, float _cellSize);
+    SpatialGrid(const SpatialGrid &other) = delete;
+    ~SpatialGrid();
+
+    SpatialGrid& operator =(const SpatialGrid &other) = delete;
+
+    // room for ids 0 to count - 1, none of them placed
+    void Reset(uint32_t count);
+    void Place(uint32_t id, const Math::Vector2 &p);
+    void Remove(uint32_t id);
+
+    // the queries append the ids they find to ids
+    void QueryRadius(const Math::Vector2 &p, float radius, Array<uint32_t> &ids) const;
+    void QueryCone(const Math::Vector2 &p, const Math::Vector2 &dir, float radius, float coneAngle, Array<uint32_t> &ids) const;
+    // up to k ids, closest first, no farther than maxRadius
+    void QueryNearest(const Math::Vector2 &p, uint32_t k, float maxRadius, Array<uint32_t> &ids) const;
+
+    float GetCellSize() const;
+    const Math::Vector2& GetPosition(uint32_t id) const;
+
+    // target within radius of p and coneAngle of dir, dir normalized
+    static bool IsInCone(const Math::Vector2 &p, const Math::Vector2 &dir, float radius, float cosConeAngle, const Math::Vector2 &target);
+};
+
+inline uint32_t
+SpatialGrid::Bucket(int32_t cx, int32_t cy) const
+{ // heads count is a power of two
+    return (((uint32_t)cx * 73856093u) ^ ((uint32_t)cy * 19349663u)) & (heads.Count() - 1);
+}
+
+inline int32_t
+SpatialGrid::Cell(float v) const
+{
+    return (int32_t)floorf(v * invCellSize);
+}
+
+inline float
+SpatialGrid::GetCellSize() const
+{
+    return cellSize;
+}
+
+inline bool
+SpatialGrid::IsInCone(const Math::Vector2 &p, const Math::Vector2 &dir, float radius, float cosConeAngle, const Math::Vector2 &target)
+{
+    Math::Vector2 toTarget = target - p;
+    float sqDist = toTarget.GetSqrMagnitude();
+    if (sqDist > radius * radius)
+        return false;
+
+    // the angle between dir and toTarget within the cone, toTarget not normalized
+    return Math::Vector2::Dot(dir, toTarget) >= cosConeAngle * sqrtf(sqDist);
+}
+
+} // namespace Game
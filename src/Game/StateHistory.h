@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cassert>
+#include "Game/StateHistory_type.h"
+#include "Core/Collections/Array.h"
+
+namespace Game {
+
+template <typename T>
+const uint32_t StateHistory<T>::kNoStep;
+
+template <typename T>
+inline
+StateHistory<T>::StateHistory(Core::Memory::Allocator &allocator, uint32_t capacity)
+: slots(allocator, capacity),
+  first(1),
+  last(0)
+{
+    assert(capacity > 0 && 0 == (capacity & (capacity - 1)));
+    slots.Resize(capacity);
+    this->Invalidate(0, capacity - 1);
+}
+
+template <typename T>
+inline
+StateHistory<T>::~StateHistory()
+{ }
+
+template <typename T>
+inline void
+StateHistory<T>::Invalidate(uint32_t fromStep, uint32_t toStep)
+{
+    uint32_t mask = slots.Count() - 1;
+    for (uint32_t step = fromStep; step <= toStep; ++step)
+        slots[step & mask].step = kNoStep;
+}
+
+template <typename T>
+inline uint32_t
+StateHistory<T>::Capacity() const
+{
+    return slots.Count();
+}
+
+template <typename T>
+inline bool
+StateHistory<T>::IsEmpty() const
+{
+    return last < first;
+}
+
+template <typename T>
+inline void
+StateHistory<T>::Push(const T &state)
+{
+    uint32_t step = state.step, capacity = slots.Count();
+    if (this->IsEmpty())
+    {
+        first = last = step;
+    }
+    else if (step > last)
+    {
+        last = step;
+        if (last - first >= capacity)
+            first = last - capacity + 1;
+    }
+    else if (step < first)
+    {
+        if (last - step >= capacity)
+            return;
+
+        // cleared states may still sit in the slots the window grows back over
+        this->Invalidate(step + 1, first - 1);
+        first = step;
+    }
+
+    slots[step & (capacity - 1)] = state;
+}
+
+template <typename T>
+inline void
+StateHistory<T>::Clear()
+{
+    this->Invalidate(0, slots.Count() - 1);
+    first = 1;
+    last = 0;
+}
+
+template <typename T>
+inline const T&
+StateHistory<T>::Newest() const
+{
+    assert(!this->IsEmpty());
+    return slots[last & (slots.Count() - 1)];
+}
+
+template <typename T>
+inline const T*
+StateHistory<T>::Find(uint32_t step) const
+{
+    if (step < first || step > last)
+        return nullptr;
+
+    const T &state = slots[step & (slots.Count() - 1)];
+    return state.step == step ? &state : nullptr;
+}
+
+template <typename T>
+inline const T*
+StateHistory<T>::FindAtOrBefore(uint32_t step) const
+{
+    if (this->IsEmpty() || step < first)
+        return nullptr;
+
+    // as far back as the gap to the previous state
+    for (uint32_t s = step < last ? step : last; ; --s)
+    {
+        const T *state = this->Find(s);
+        if (state != nullptr)
+            return state;
+        if (s == first)
+            return nullptr;
+    }
+}
+
+template <typename T>
+inline const T*
+StateHistory<T>::FindAtOrAfter(uint32_t step) const
+{
+    if (this->IsEmpty() || step > last)
+        return nullptr;
+
+    for (uint32_t s = step > first ? step : first; s <= last; ++s)
+    {
+        const T *state = this->Find(s);
+        if (state != nullptr)
+            return state;
+    }
+    return nullptr;
+}
+
+} // namespace Game
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include "Core/Collections/Array_type.h"
+
+namespace Game {
+
+using Core::Collections::Array;
+
+// The last capacity steps of an entity's states, T being a state with a step. Every state sits in
+// the slot of its step modulo capacity, so a push or the lookup of a step is O(1), and a state
+// whose slot holds another step is missing. The states don't need to be pushed in order, nor one
+// per step, a client only gets the ones the server sent.
+template <typename T>
+class StateHistory
+{
+private:
+    static const uint32_t kNoStep = 0xffffffff;
+
+    Array<T> slots; // capacity, a power of two
+    uint32_t first, last; // the window, empty if last < first
+
+    void Invalidate(uint32_t fromStep, uint32_t toStep);
+public:
+    StateHistory(Core::Memory::Allocator &allocator, uint32_t capacity);
+    StateHistory(const StateHistory<T> &other) = delete;
+    ~StateHistory();
+
+    StateHistory<T>& operator =(const StateHistory<T> &other) = delete;
+
+    uint32_t Capacity() const;
+    bool IsEmpty() const;
+
+    // replaces the state of the same step, states older than the window are dropped
+    void Push(const T &state);
+    void Clear();
+
+    const T& Newest() const;
+    // nullptr if missing
+    const T* Find(uint32_t step) const;
+    // the newest state at or before step, the oldest at or after it, nullptr if none
+    const T* FindAtOrBefore(uint32_t step) const;
+    const T* FindAtOrAfter(uint32_t step) const;
+};
+
+} // namespace Game
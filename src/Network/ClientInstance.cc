@@ -1,15 +1,19 @@
+#include <algorithm>
 #include "Network/ClientInstance.h"
 #include "Core/Memory/MallocAllocator.h"
 #include "Core/Memory/LinearAllocator.h"
 #include "Core/Memory/BlocksAllocator.h"
+#include "Core/Collections/Array.h"
 #include "Core/Collections/Queue.h"
 #include "Core/IO/BitStream.h"
 #include "Network/Messages/CreateRoom.h"
 #include "Network/Messages/JoinRoom.h"
+#include "Network/Messages/QuickJoin.h"
 #include "Network/Messages/StartGame.h"
 #include "Network/Messages/PlayerState.h"
-#include "Network/Messages/PlayerInputs.h"
+#include "Network/Messages/PlayerInputsWindow.h"
 #include "Network/Messages/EnemyState.h"
+#include "Network/Messages/RoomSnapshot.h"
 
 using namespace Core;
 using namespace Core::IO;
@@ -21,13 +25,26 @@ namespace Network {
 ClientInstance::ClientInstance()
 : HostInstance(),
   server(nullptr),
+  sendQueue(GetAllocator<MallocAllocator>()),
   active(false),
   state(Disconnected),
   roomCreationCallback(nullptr),
   joinRoomCallback(nullptr),
   startGameCallback(nullptr),
-  sendQueue(GetAllocator<MallocAllocator>())
-{ }
+  confirmedStep(0),
+  correctionsCount(0),
+  lastSnapshot(0),
+  inputsWindow(SmartPtr<Messages::PlayerInputsWindow>::MakeNew<BlocksAllocator>()),
+  sendStream(GetAllocator<MallocAllocator>())
+{
+    dispatcher.Register<Messages::CreateRoom, &ClientInstance::OnCreateRoom>();
+    dispatcher.Register<Messages::JoinRoom, &ClientInstance::OnJoinRoom>();
+    dispatcher.Register<Messages::QuickJoin, &ClientInstance::OnQuickJoin>();
+    dispatcher.Register<Messages::StartGame, &ClientInstance::OnStartGame>();
+    dispatcher.Register<Messages::RoomSnapshot, &ClientInstance::PrepareRoomSnapshot, &ClientInstance::OnRoomSnapshot>();
+
+    this->ResetGameStats();
+}
 
 ClientInstance::~ClientInstance()
 { }
@@ -41,7 +58,8 @@ ClientInstance::Initialize(const char *serverHost, int serverPort)
 void
 ClientInstance::Tick()
 {
-    timeServer->Tick();
+    if (!shared)
+        timeServer->Tick();
 
     ENetEvent event;
     while (enet_host_service(host, &event, 0) > 0)
@@ -81,89 +99,8 @@ ClientInstance::Tick()
             break;
         case ENET_EVENT_TYPE_RECEIVE:
             BitStream data(GetAllocator<MallocAllocator>(), event.packet->data, event.packet->dataLength, false);
-            uint32_t fcc;
-            data >> fcc;
-            auto classInfo = ClassInfoUtils::Instance()->FindClassFCC(fcc);
-            if (classInfo != nullptr)
-            {
-                auto ptr = SmartPtr<Network::Serializable>::CastFrom(classInfo->Create(&GetAllocator<BlocksAllocator>()));
-                ptr->Deserialize(event.peer, data);
-
-                if (ptr->IsInstanceOf<Messages::CreateRoom>())
-                {
-                    auto createRoom = SmartPtr<Messages::CreateRoom>::CastFrom(ptr);
-
-                    assert(roomCreationCallback != nullptr);
-                    roomCreationCallback(createRoom->roomId);
-                    roomCreationCallback = nullptr;
-                }
-                else if (ptr->IsInstanceOf<Messages::JoinRoom>())
-                {
-                    bool success = false;
-
-                    if (state < JoinedRoom)
-                    {
-                        auto joinRoom = SmartPtr<Messages::JoinRoom>::CastFrom(ptr);
-                        success = Messages::JoinRoom::Success == joinRoom->flags;
-                        if (success)
-                        {
-                            roomId = joinRoom->roomId;
-                            joinedRoomData = joinRoom->roomData;
-                            state = JoinedRoom;
-                            log->Write(Log::Info, "Joined room %u.", roomId);
-                        }
-                    }
-
-                    assert(joinRoomCallback != nullptr);
-                    joinRoomCallback(success);
-                    joinRoomCallback = nullptr;
-                }
-                else if (ptr->IsInstanceOf<Messages::StartGame>())
-                {
-                    bool success = false;
-                    if (Waiting == state)
-                    {
-                        auto startGame = SmartPtr<Messages::StartGame>::CastFrom(ptr);
-                        success = Messages::StartGame::Go == startGame->flags;
-                        if (success)
-                        {
-                            playerId = startGame->playerId;
-                            accumulator = simTime = .0f;
-                            lastTimestamp = startGame->goTime;
-                            simStep = 0;
-
-                            level = SmartPtr<Game::Level>::MakeNew<BlocksAllocator>();
-                            level->Init(joinedRoomData, playerId);
-                            joinedRoomData.Reset();
-
-                            state = Playing;
-                            log->Write(Log::Info, "Starting game for player at time %f (now: %f).", lastTimestamp, Core::Time::TimeServer::Instance()->GetRealTime());
-                        }
-                    }
-
-                    assert(startGameCallback != nullptr);
-                    startGameCallback(success);
-                    startGameCallback = nullptr;
-                }
-                else if (ptr->IsInstanceOf<Messages::PlayerState>())
-                {
-                    if (level.IsValid() && Playing == state && !timeServer->IsPaused())
-                    {
-                        auto playerState = SmartPtr<Messages::PlayerState>::CastFrom(ptr);
-
-                        level->GetPlayer(playerState->id)->SendPlayerState(playerState);
-                    }
-                }
-                else if (ptr->IsInstanceOf<Messages::EnemyState>())
-                {
-                    if (level.IsValid() && Playing == state && !timeServer->IsPaused())
-                    {
-                        auto enemyState = SmartPtr<Messages::EnemyState>::CastFrom(ptr);
-
-                        level->GetEnemy(enemyState->id)->SendEnemyState(enemyState);
-                    }
-                }
-            }
+            dispatcher.Dispatch(this, event, event.peer, data);
+
             enet_packet_destroy(event.packet);
             break;
         }
@@ -205,6 +142,140 @@ ClientInstance::Tick()
     RefCounted::GC.Collect();
 }
 
+void
+ClientInstance::ResetGameStats()
+{
+    Memory::Zero(&gameStats);
+}
+
+bool
+ClientInstance::IsSimulating() const
+{
+    return level.IsValid() && Playing == state && !timeServer->IsPaused();
+}
+
+void
+ClientInstance::OnCreateRoom(const ENetEvent &event, const SmartPtr<Messages::CreateRoom> &createRoom)
+{
+    assert(roomCreationCallback != nullptr);
+    roomCreationCallback(createRoom->roomId);
+    roomCreationCallback = nullptr;
+}
+
+void
+ClientInstance::OnJoinRoom(const ENetEvent &event, const SmartPtr<Messages::JoinRoom> &joinRoom)
+{
+    bool success = false;
+
+    if (state < JoinedRoom)
+    {
+        success = Messages::JoinRoom::Success == joinRoom->flags;
+        if (success)
+        {
+            roomId = joinRoom->roomId;
+            joinedRoomData = joinRoom->roomData;
+            state = JoinedRoom;
+            log->Write(Log::Info, "Joined room %u.", roomId);
+        }
+    }
+
+    assert(joinRoomCallback != nullptr);
+    joinRoomCallback(success);
+    joinRoomCallback = nullptr;
+}
+
+void
+ClientInstance::OnQuickJoin(const ENetEvent &event, const SmartPtr<Messages::QuickJoin> &quickJoin)
+{ // answered as a JoinRoom, with the room the server picked
+    this->OnJoinRoom(event, SmartPtr<Messages::JoinRoom>::CastFrom(quickJoin));
+}
+
+void
+ClientInstance::OnStartGame(const ENetEvent &event, const SmartPtr<Messages::StartGame> &startGame)
+{
+    bool success = false;
+    if (Waiting == state)
+    {
+        success = Messages::StartGame::Go == startGame->flags;
+        if (success)
+        {
+            playerId = startGame->playerId;
+            accumulator = simTime = .0f;
+            startTime = lastTimestamp = startGame->goTime;
+            simStep = 0;
+            confirmedStep = 0;
+            correctionsCount = 0;
+            this->ResetGameStats();
+
+            level = SmartPtr<Game::Level>::MakeNew<BlocksAllocator>();
+            level->Init(joinedRoomData, playerId);
+            joinedRoomData.Reset();
+
+            snapshots.Clear();
+            lastSnapshot = 0;
+            inputsWindow->Clear();
+
+            state = Playing;
+            log->Write(Log::Info, "Starting game for player at time %f (now: %f).", lastTimestamp, Core::Time::TimeServer::Instance()->GetRealTime());
+        }
+    }
+
+    assert(startGameCallback != nullptr);
+    startGameCallback(success);
+    startGameCallback = nullptr;
+}
+
+void
+ClientInstance::PrepareRoomSnapshot(Messages::RoomSnapshot *snapshot)
+{
+    snapshot->history = &snapshots; // its baseline
+}
+
+void
+ClientInstance::OnRoomSnapshot(const ENetEvent &event, const SmartPtr<Messages::RoomSnapshot> &snapshot)
+{
+    if (!this->IsSimulating() || !snapshot->complete)
+        return;
+
+    // entities that match the baseline were applied with it already
+    for (uint8_t i = 0; i < snapshot->playersCount; ++i)
+    {
+        if (snapshot->playersChanged[i])
+            level->GetPlayer(snapshot->players[i]->id)->SendPlayerState(snapshot->players[i]);
+    }
+
+    for (uint8_t i = 0; i < snapshot->enemiesCount; ++i)
+    {
+        if (snapshot->enemiesChanged[i])
+            level->GetEnemy(snapshot->enemies[i]->id)->SendEnemyState(snapshot->enemies[i]);
+    }
+
+    snapshots.Store(snapshot);
+    if (Messages::RoomSnapshot::IsNewer(snapshot->sequence, lastSnapshot))
+        lastSnapshot = snapshot->sequence;
+
+    ++gameStats.snapshots;
+
+    uint32_t corrections = level->GetPlayer(playerId)->GetCorrectionsCount();
+    gameStats.corrections += corrections - correctionsCount;
+    correctionsCount = corrections;
+
+    // the server's player is one step past the last input it ran, that input went out at its sim step time
+    if (playerId < snapshot->playersCount && snapshot->relevant[playerId])
+    {
+        uint32_t step = snapshot->players[playerId]->step;
+        if (step > confirmedStep + 1)
+        {
+            confirmedStep = step - 1;
+
+            float latency = timeServer->GetRealTime() - (startTime + confirmedStep * kFixedTimeStep);
+            ++gameStats.confirmedInputs;
+            gameStats.inputLatency += latency;
+            gameStats.maxInputLatency = std::max(gameStats.maxInputLatency, latency);
+        }
+    }
+}
+
 void
 ClientInstance::RequestPause()
 {
@@ -281,6 +352,24 @@ ClientInstance::JoinRoom(uint32_t roomId, JoinRoomCallback callback)
         callback(false);
 }
 
+void
+ClientInstance::QuickJoin(uint8_t playersCount, JoinRoomCallback callback)
+{
+    if (Connected == state && nullptr == joinRoomCallback)
+    {
+        joinRoomCallback = callback;
+
+        auto quickJoin = SmartPtr<Messages::QuickJoin>::MakeNew<MallocAllocator>();
+        quickJoin->roomId = Messages::CreateRoom::kUnknownId;
+        quickJoin->flags = Messages::JoinRoom::Request;
+        quickJoin->playersCount = playersCount;
+
+        this->Send(SmartPtr<Network::Serializable>::CastFrom(quickJoin), ReliableSequenced, 1);
+    }
+    else
+        callback(false);
+}
+
 void
 ClientInstance::StartGame(StartGameCallback callback)
 {
@@ -307,10 +396,8 @@ ClientInstance::Send(const SmartPtr<Serializable> &object, MessageType messageTy
 {
     if (server != nullptr)
     {
-        BitStream data(GetAllocator<ScratchAllocator>());
-
-        object->Serialize(server, data);
-        ENetPacket *packet = enet_packet_create(data.GetData(), data.GetSize(), this->MessageTypeToFlags(messageType));
+        object->Serialize(server, sendStream);
+        ENetPacket *packet = enet_packet_create(sendStream.GetData(), sendStream.GetSize(), this->MessageTypeToFlags(messageType));
 
         enet_peer_send(server, channel, packet);
     }
@@ -323,15 +410,13 @@ ClientInstance::Send(const SmartPtr<Serializable> &object, MessageType messageTy
 void
 ClientInstance::SendPlayerInputs(float x, float y, bool attack)
 {
-    auto playerInputs = SmartPtr<Messages::PlayerInputs>::MakeNew<ScratchAllocator>();
-    playerInputs->step = simStep;
-    playerInputs->x = x;
-    playerInputs->y = y;
-    playerInputs->attack = attack;
+    // the window goes out whole every step, a lost packet costs nothing if the next one arrives
+    const Game::Player::Input &input = inputsWindow->Push(simStep, x, y, attack);
+    inputsWindow->lastSnapshot = lastSnapshot;
 
-    level->GetPlayer(playerId)->SendPlayerInput(playerInputs);
+    level->GetPlayer(playerId)->SendPlayerInput(input);
 
-    this->Send(SmartPtr<Serializable>::CastFrom(playerInputs), Unsequenced, 0);
+    this->Send(SmartPtr<Serializable>::CastFrom(inputsWindow), Unsequenced, 0);
 }
 
 void
@@ -351,7 +436,7 @@ ClientInstance::GetPlayerState(uint8_t id, float *x, float *y, float *dx, float
         else
         {
             Game::Player::ActionState _state;
-            player->GetStateAtTime(simTime - 0.2f, x, y, dx, dy, &_state, time);
+            player->GetStateAtTime(simTime - Game::Level::kViewDelay, x, y, dx, dy, &_state, time);
             *state = _state;
         }
     }
@@ -361,7 +446,13 @@ void
 ClientInstance::GetEnemyPosition(uint8_t enemyId, float *x, float *y)
 {
     if (level.IsValid())
-        level->GetEnemy(enemyId)->GetPositionAtTime(simTime - 0.2f, x, y);
+        level->GetEnemy(enemyId)->GetPositionAtTime(simTime - Game::Level::kViewDelay, x, y);
+}
+
+uint8_t
+ClientInstance::GetEnemyHealth(uint8_t enemyId)
+{
+    return level.IsValid() ? level->GetEnemy(enemyId)->GetCurrentHealth() : 0;
 }
 
 }; // namespace Network
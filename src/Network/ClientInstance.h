@@ -2,6 +2,16 @@
 
 #include "Network/HostInstance.h"
 #include "Network/Serializable.h"
+#include "Network/Messages/CreateRoom.h"
+#include "Network/Messages/JoinRoom.h"
+#include "Network/Messages/QuickJoin.h"
+#include "Network/Messages/StartGame.h"
+#include "Network/Messages/PlayerState.h"
+#include "Network/Messages/EnemyState.h"
+#include "Network/Messages/RoomSnapshot.h"
+#include "Network/Messages/PlayerInputsWindow.h"
+#include "Network/MessageDispatcher.h"
+#include "Network/NetStats.h"
 #include "Core/Collections/Queue_type.h"
 #include "Game/Level.h"
 
@@ -21,6 +31,16 @@ public:
         Waiting,
         Playing
     };
+
+    // What the game looked like from here since it started, for headless clients measuring a server
+    struct GameStats // since the game started or the last reset
+    {
+        uint32_t snapshots;         // applied, those missing their baseline don't count
+        uint32_t corrections;       // own player states that didn't match the prediction
+        uint32_t confirmedInputs;   // snapshots carrying the result of a newer input of ours
+        float inputLatency;         // seconds from sending those inputs to their snapshot, summed
+        float maxInputLatency;
+    };
 protected:
     struct QueuedMsg
     {
@@ -48,11 +68,31 @@ protected:
 
     uint32_t roomId;
     uint8_t playerId;
+    float startTime;
     float lastTimestamp;
     float accumulator, simTime;
     uint32_t simStep;
+    uint32_t confirmedStep;     // the last of our inputs a snapshot showed the result of
+    uint32_t correctionsCount;  // the own player's, as of the last snapshot
+    GameStats gameStats;
     SmartPtr<GameRoomData> joinedRoomData;
     SmartPtr<Game::Level> level;
+
+    Messages::RoomSnapshotHistory snapshots;
+    uint16_t lastSnapshot;
+
+    MessageDispatcher<ClientInstance, ENetEvent> dispatcher;
+    SmartPtr<Messages::PlayerInputsWindow> inputsWindow;
+    Core::IO::BitStream sendStream;
+
+    bool IsSimulating() const;
+
+    void OnCreateRoom(const ENetEvent &event, const SmartPtr<Messages::CreateRoom> &createRoom);
+    void OnJoinRoom(const ENetEvent &event, const SmartPtr<Messages::JoinRoom> &joinRoom);
+    void OnQuickJoin(const ENetEvent &event, const SmartPtr<Messages::QuickJoin> &quickJoin);
+    void OnStartGame(const ENetEvent &event, const SmartPtr<Messages::StartGame> &startGame);
+    void PrepareRoomSnapshot(Messages::RoomSnapshot *snapshot);
+    void OnRoomSnapshot(const ENetEvent &event, const SmartPtr<Messages::RoomSnapshot> &snapshot);
 public:
     ClientInstance();
     virtual ~ClientInstance();
@@ -66,6 +106,8 @@ public:
 
     void CreateRoom(uint8_t playersCount, RoomCreationCallback callback);
     void JoinRoom(uint32_t roomId, JoinRoomCallback callback);
+    // into any room for playersCount players, the server makes one if none is waiting
+    void QuickJoin(uint8_t playersCount, JoinRoomCallback callback);
     void StartGame(StartGameCallback callback);
     void Send(const SmartPtr<Serializable> &object, MessageType messageType, uint8_t channel);
 
@@ -74,10 +116,16 @@ public:
     uint8_t GetPlayerId() const;
     float GetRTT() const;
     uint8_t GetPlayersCount() const;
+    uint32_t GetSimStep() const;
+    const GameStats& GetGameStats() const;
+    void ResetGameStats();
+    // the connection to the server since it was made, false without one
+    bool GetPeerStats(NetStats::PeerStats &stats) const;
 
     void SendPlayerInputs(float x, float y, bool attack);
     void GetPlayerState(uint8_t id, float *x, float *y, float *dx, float *dy, int32_t *state, float *time);
     void GetEnemyPosition(uint8_t enemyId, float *x, float *y);
+    uint8_t GetEnemyHealth(uint8_t enemyId);
 
     static ClientInstance* Instance();
 };
@@ -118,6 +166,28 @@ ClientInstance::GetPlayersCount() const
         return 0;
 }
 
+inline uint32_t
+ClientInstance::GetSimStep() const
+{
+    return simStep;
+}
+
+inline const ClientInstance::GameStats&
+ClientInstance::GetGameStats() const
+{
+    return gameStats;
+}
+
+inline bool
+ClientInstance::GetPeerStats(NetStats::PeerStats &stats) const
+{
+    if (nullptr == server)
+        return false;
+
+    NetStats::GetPeer(server, stats);
+    return true;
+}
+
 inline ClientInstance*
 ClientInstance::Instance()
 {
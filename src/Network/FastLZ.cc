@@ -0,0 +1,216 @@
+#include <algorithm>
+#include "Network/FastLZ.h"
+#include "Core/Debug.h"
+#include "Core/Memory/Memory.h"
+#include "Core/Memory/MallocAllocator.h"
+
+using namespace Core::Memory;
+
+namespace Network {
+
+static inline uint32_t
+Read32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t
+Hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - FastLZ::kHashBits);
+}
+
+// 15 in a token nibble goes on in bytes of 255 and a last one smaller
+static inline bool
+WriteLength(uint8_t *&op, const uint8_t *outEnd, size_t length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        if (op >= outEnd)
+            return false;
+        *op++ = 255;
+    }
+
+    if (op >= outEnd)
+        return false;
+    *op++ = (uint8_t)length;
+    return true;
+}
+
+static inline bool
+ReadLength(const uint8_t *&ip, const uint8_t *inEnd, size_t &length)
+{
+    uint8_t value;
+    do
+    {
+        if (ip >= inEnd)
+            return false;
+        value = *ip++;
+        length += value;
+    } while (255 == value);
+
+    return true;
+}
+
+static bool
+WriteSequence(uint8_t *&op, const uint8_t *outEnd, const uint8_t *literals, size_t literalsCount, size_t offset, size_t matchLength)
+{
+    if (op >= outEnd)
+        return false;
+
+    uint8_t *token = op++;
+    *token = (uint8_t)((literalsCount < 15 ? literalsCount : 15) << 4);
+    if (literalsCount >= 15 && !WriteLength(op, outEnd, literalsCount - 15))
+        return false;
+
+    if ((size_t)(outEnd - op) < literalsCount)
+        return false;
+    memcpy(op, literals, literalsCount);
+    op += literalsCount;
+
+    if (0 == matchLength)
+        return true; // the last one
+
+    if (outEnd - op < 2)
+        return false;
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+
+    size_t length = matchLength - FastLZ::kMinMatch;
+    *token |= (uint8_t)(length < 15 ? length : 15);
+    return length < 15 || WriteLength(op, outEnd, length - 15);
+}
+
+size_t
+FastLZ::Compress(Context *context, const uint8_t *in, size_t inSize, uint8_t *out, size_t outLimit)
+{
+    assert(inSize <= 0xffff);
+
+    Zero(context->table, 1 << kHashBits);
+
+    const uint8_t *outEnd = out + outLimit;
+    uint8_t *op = out;
+
+    size_t ip = 0, anchor = 0;
+    while (ip + kMinMatch <= inSize)
+    {
+        uint32_t sequence = Read32(in + ip),
+                 hash = Hash(sequence);
+        size_t candidate = context->table[hash];
+        context->table[hash] = (uint16_t)(ip + 1);
+
+        if (0 == candidate-- || Read32(in + candidate) != sequence)
+        {
+            ++ip;
+            continue;
+        }
+
+        size_t matchLength = kMinMatch;
+        while (ip + matchLength < inSize && in[candidate + matchLength] == in[ip + matchLength])
+            ++matchLength;
+
+        if (!WriteSequence(op, outEnd, in + anchor, ip - anchor, ip - candidate, matchLength))
+            return 0;
+
+        ip += matchLength;
+        anchor = ip;
+    }
+
+    if (!WriteSequence(op, outEnd, in + anchor, inSize - anchor, 0, 0))
+        return 0;
+
+    return op - out;
+}
+
+size_t
+FastLZ::Decompress(const uint8_t *in, size_t inSize, uint8_t *out, size_t outLimit)
+{
+    const uint8_t *ip = in, *inEnd = in + inSize;
+    uint8_t *op = out, *outEnd = out + outLimit;
+
+    while (ip < inEnd)
+    {
+        uint8_t token = *ip++;
+
+        size_t literalsCount = token >> 4;
+        if (15 == literalsCount && !ReadLength(ip, inEnd, literalsCount))
+            return 0;
+
+        if ((size_t)(inEnd - ip) < literalsCount || (size_t)(outEnd - op) < literalsCount)
+            return 0;
+        memcpy(op, ip, literalsCount);
+        ip += literalsCount;
+        op += literalsCount;
+
+        if (ip == inEnd)
+            break; // the last sequence
+
+        if (inEnd - ip < 2)
+            return 0;
+        size_t offset = ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+
+        size_t matchLength = token & 15;
+        if (15 == matchLength && !ReadLength(ip, inEnd, matchLength))
+            return 0;
+        matchLength += kMinMatch;
+
+        if (0 == offset || offset > (size_t)(op - out) || (size_t)(outEnd - op) < matchLength)
+            return 0;
+
+        // byte by byte, the match may overlap what it writes
+        const uint8_t *match = op - offset;
+        for (size_t i = 0; i < matchLength; ++i)
+            op[i] = match[i];
+        op += matchLength;
+    }
+
+    return op - out;
+}
+
+static size_t ENET_CALLBACK
+CompressCallback(void *context, const ENetBuffer *inBuffers, size_t inBufferCount, size_t inLimit, enet_uint8 *outData, size_t outLimit)
+{
+    FastLZ::Context *lzContext = static_cast<FastLZ::Context*>(context);
+    if (inLimit > sizeof(lzContext->input))
+        return 0;
+
+    size_t inSize = 0;
+    for (size_t i = 0; i < inBufferCount && inSize < inLimit; ++i)
+    {
+        size_t size = std::min(inBuffers[i].dataLength, inLimit - inSize);
+        memcpy(lzContext->input + inSize, inBuffers[i].data, size);
+        inSize += size;
+    }
+
+    return FastLZ::Compress(lzContext, lzContext->input, inSize, outData, outLimit);
+}
+
+static size_t ENET_CALLBACK
+DecompressCallback(void *context, const enet_uint8 *inData, size_t inLimit, enet_uint8 *outData, size_t outLimit)
+{
+    return FastLZ::Decompress(inData, inLimit, outData, outLimit);
+}
+
+static void ENET_CALLBACK
+DestroyCallback(void *context)
+{
+    Delete<MallocAllocator>(static_cast<FastLZ::Context*>(context));
+}
+
+bool
+FastLZ::SetOnHost(ENetHost *host)
+{
+    ENetCompressor compressor;
+    compressor.context = New<MallocAllocator, Context>();
+    compressor.compress = &CompressCallback;
+    compressor.decompress = &DecompressCallback;
+    compressor.destroy = &DestroyCallback;
+
+    enet_host_compress(host, &compressor);
+    return true;
+}
+
+}; // namespace Network
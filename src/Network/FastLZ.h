@@ -0,0 +1,36 @@
+#pragma once
+
+#define NOMINMAX
+#include "enet/enet.h"
+
+#include <cstdint>
+#include <cstddef>
+
+namespace Network {
+
+// LZ77 byte coder after LZ4's block format, an ENetCompressor that costs far less CPU
+// than the range coder: no entropy stage, one hash probe per input byte at most.
+// A sequence is a token (literals count and match length, 4 bits each, 15 goes on in
+// the bytes after), the literals, then a 16 bits offset back to the match.
+// The last sequence has literals only. Both ends of a connection need the same compressor.
+class FastLZ {
+public:
+    static const uint32_t kHashBits = 10;
+    static const uint32_t kMinMatch = 4;
+
+    struct Context
+    {
+        uint8_t input[ENET_PROTOCOL_MAXIMUM_MTU];   // ENet hands the packet over in pieces
+        uint16_t table[1 << kHashBits];             // last position + 1 by hash of 4 bytes, 0 is none
+    };
+
+    // 0 if it doesn't fit outLimit
+    static size_t Compress(Context *context, const uint8_t *in, size_t inSize, uint8_t *out, size_t outLimit);
+    // 0 if the data is malformed or doesn't fit outLimit
+    static size_t Decompress(const uint8_t *in, size_t inSize, uint8_t *out, size_t outLimit);
+
+    // the context goes away with the host, or the next compressor set on it
+    static bool SetOnHost(ENetHost *host);
+};
+
+}; // namespace Network
@@ -1,3 +1,5 @@
+#include <cstring>
+#include <algorithm>
 #include "Network/GameRoom.h"
 #include "Core/Collections/Array.h"
 #include "Core/Memory/MallocAllocator.h"
@@ -6,8 +8,6 @@
 #include "Core/SmartPtr.h"
 #include "Core/Time/TimeServer.h"
 #include "Network/ServerInstance.h"
-#include "Network/Messages/PlayerState.h"
-#include "Network/Messages/EnemyState.h"
 
 using namespace Core::Memory;
 
@@ -15,15 +15,31 @@ namespace Network {
 
 DefineClassInfo(Network::GameRoom, Core::Pool::BaseObject);
 
+constexpr int GameRoom::kStepsCount;
+constexpr float GameRoom::kServerFixedTime;
+constexpr uint64_t GameRoom::kServerFixedNanoseconds;
+
 GameRoom::GameRoom(uint8_t playersCount)
 : lifeTime(.0f),
   state(WaitingJoin),
+  openSlot(OpenRooms::kNoSlot),
   peers(GetAllocator<MallocAllocator>(), playersCount),
   startGameMsgs(GetAllocator<MallocAllocator>(), playersCount),
-  lastTimestamp(.0f),
-  accumulator(.0f), simTime(.0f),
+  lastTimestamp(0),
+  accumulator(0), simTime(.0f),
   simStep(0),
-  data(SmartPtr<GameRoomData>::MakeNew<MallocAllocator>())
+  stepPhase(0),
+  data(SmartPtr<GameRoomData>::MakeNew<MallocAllocator>()),
+  arena(New<MallocAllocator, ArenaAllocator>(&GetAllocator<MallocAllocator>(), kArenaChunkSize)),
+  snapshotSequence(0),
+  peerSnapshotAcks(GetAllocator<MallocAllocator>(), playersCount),
+  peerInterests(GetAllocator<MallocAllocator>()),
+  peerPriorities(GetAllocator<MallocAllocator>()),
+  interestStride(0),
+  peerSentEntities(GetAllocator<MallocAllocator>()),
+  sendOrder(GetAllocator<MallocAllocator>()),
+  sendStream(GetAllocator<MallocAllocator>()),
+  outgoing(GetAllocator<MallocAllocator>())
 {
     data->playersData.Resize(playersCount);
     data->enemiesData.Resize(1);
@@ -36,6 +52,37 @@ GameRoom::GameRoom(uint8_t playersCount)
     enemyData.p2y = -10.0f;
 }
 
+GameRoom::GameRoom(GameRoom &&other)
+: Core::Pool::BaseObject(std::move(other)),
+  lifeTime(other.lifeTime),
+  state(other.state),
+  openSlot(other.openSlot),
+  peers(std::move(other.peers)),
+  startGameMsgs(std::move(other.startGameMsgs)),
+  lastTimestamp(other.lastTimestamp),
+  accumulator(other.accumulator),
+  simTime(other.simTime),
+  simStep(other.simStep),
+  stepPhase(other.stepPhase),
+  data(std::move(other.data)),
+  arena(other.arena),
+  level(std::move(other.level)),
+  snapshots(std::move(other.snapshots)),
+  snapshotSequence(other.snapshotSequence),
+  peerSnapshotAcks(std::move(other.peerSnapshotAcks)),
+  peerInterests(std::move(other.peerInterests)),
+  peerPriorities(std::move(other.peerPriorities)),
+  interestStride(other.interestStride),
+  peerSentEntities(std::move(other.peerSentEntities)),
+  sendOrder(std::move(other.sendOrder)),
+  sendStream(std::move(other.sendStream)),
+  outgoing(std::move(other.outgoing))
+{
+    // the arena goes with the level, the moved-from room must not delete it nor give back the phase
+    other.arena = nullptr;
+    other.state = WaitingJoin;
+}
+
 GameRoom::~GameRoom()
 {
     if (WaitingPlayers == state)
@@ -48,8 +95,22 @@ GameRoom::~GameRoom()
         }
     }
 
+    if (Playing == state)
+        ServerInstance::Instance()->ReleaseStepPhase(stepPhase);
+
+    for (auto it = outgoing.Begin(), end = outgoing.End(); it != end; ++it)
+    {
+        if (it + 1 == end || (it + 1)->packet != it->packet)
+            enet_packet_destroy(it->packet);
+    }
+
+    // the level and its entities are in the arena, nothing else may hold them when it goes
+    assert(!level.IsValid() || 1 == level->GetRefCount());
     level.Reset();
     data.Reset();
+
+    if (arena != nullptr)
+        Delete<MallocAllocator>(arena);
 }
 
 void
@@ -57,6 +118,7 @@ GameRoom::AddPlayer(ENetPeer *peer)
 {
     assert(WaitingJoin == state && peers.Count() < peers.Capacity());
     peers.PushBack(peer);
+    peerSnapshotAcks.PushBack(0);
     if (peers.Count() == peers.Capacity())
         state = WaitingPlayers;
 }
@@ -83,16 +145,21 @@ GameRoom::PlayerReady(ENetPeer *peer, const SmartPtr<Messages::StartGame> &start
             startGameMsgs.PushBack(startGame);
             if (startGameMsgs.Count() == startGameMsgs.Capacity())
             {
-                float goTime = Core::Time::TimeServer::Instance()->GetSeconds();
+                uint64_t goTime = Core::Time::TimeServer::Instance()->GetNanoseconds();
                 enet_uint32 maxRTT = 0;
                 for (it = peers.Begin(); it != end; ++it)
                     maxRTT = std::max(maxRTT, (*it)->roundTripTime);
-                goTime += ((float)(maxRTT >> 1) * 0.0015f);
+                goTime += (uint64_t)(maxRTT >> 1) * 1500000; // half the RTT plus a half, in ns
+
+                // delayed to the room's phase of the server step, rooms started together step apart
+                stepPhase = ServerInstance::Instance()->TakeStepPhase();
+                uint64_t phaseTime = stepPhase * kServerFixedNanoseconds / ServerInstance::kStepPhases;
+                goTime += (phaseTime + kServerFixedNanoseconds - goTime % kServerFixedNanoseconds) % kServerFixedNanoseconds;
 
                 for (it2 = startGameMsgs.Begin(), end2 = startGameMsgs.End(); it2 != end2; ++it2)
                 {
                     (*it2)->flags = Messages::StartGame::Go;
-                    (*it2)->goTime = goTime;
+                    (*it2)->goTime = Core::Time::TimeServer::ToSeconds(goTime);
 
                     Core::Log::Instance()->Write(Core::Log::Info, "Starting game for player %d at time %f.", (*it2)->playerId, (*it2)->goTime);
 
@@ -102,13 +169,27 @@ GameRoom::PlayerReady(ENetPeer *peer, const SmartPtr<Messages::StartGame> &start
                 startGameMsgs.Clear();
                 startGameMsgs.Trim();
 
-                accumulator = simTime = .0f;
+                accumulator = 0;
+                simTime = .0f;
                 simStep = 0;
                 lastTimestamp = goTime;
 
-                level = SmartPtr<Game::Level>::MakeNew<BlocksAllocator>();
+                level = SmartPtr<Game::Level>::MakeNewIn(arena, arena);
                 level->Init(data);
 
+                // created here, on the main thread, and reused by every update job
+                snapshots.Reserve(level->PlayersEnd() - level->PlayersBegin(), level->EnemiesEnd() - level->EnemiesBegin());
+                snapshotSequence = 0;
+                for (auto ackIt = peerSnapshotAcks.Begin(), ackEnd = peerSnapshotAcks.End(); ackIt != ackEnd; ++ackIt)
+                    *ackIt = 0;
+
+                interestStride = (level->PlayersEnd() - level->PlayersBegin()) + (level->EnemiesEnd() - level->EnemiesBegin());
+                peerInterests.Resize(peers.Count() * interestStride);
+                peerPriorities.Resize(peers.Count() * interestStride);
+                peerSentEntities.Resize(peers.Count() * Messages::RoomSnapshot::kHistorySize * interestStride);
+                sendOrder.Resize(interestStride);
+                this->ResetInterests();
+
                 state = Playing;
             }
 
@@ -125,6 +206,7 @@ GameRoom::PlayerLeft(ENetPeer *peer)
     if (playerId > -1)
     {
         peers.RemoveAt(playerId);
+        peerSnapshotAcks.RemoveAt(playerId);
 
         switch (state)
         {
@@ -145,6 +227,13 @@ GameRoom::PlayerLeft(ENetPeer *peer)
             return true;
         case Network::GameRoom::Playing:
             level->DeletePlayer(playerId);
+
+            // ids past playerId moved down, what went out so far doesn't match anymore
+            peerInterests.RemoveRange(playerId * interestStride, interestStride);
+            peerPriorities.RemoveRange(playerId * interestStride, interestStride);
+            peerSentEntities.RemoveRange(playerId * Messages::RoomSnapshot::kHistorySize * interestStride, Messages::RoomSnapshot::kHistorySize * interestStride);
+            this->ResetInterests();
+            snapshots.Invalidate();
             return 0 == peers.Count();
         }
     }
@@ -156,7 +245,31 @@ GameRoom::RecvPlayerInputs(ENetPeer *peer, const SmartPtr<Messages::PlayerInputs
 {
     int32_t playerId = peers.IndexOf(peer);
     if (playerId > -1)
+    {
         level->GetPlayer(playerId)->SendPlayerInput(playerInputs);
+
+        // inputs are unsequenced, an older one may come in late
+        uint16_t &ack = peerSnapshotAcks[playerId];
+        if (Messages::RoomSnapshot::IsNewer(playerInputs->lastSnapshot, ack))
+            ack = playerInputs->lastSnapshot;
+    }
+}
+
+void
+GameRoom::RecvPlayerInputs(ENetPeer *peer, const SmartPtr<Messages::PlayerInputsWindow> &inputsWindow)
+{
+    int32_t playerId = peers.IndexOf(peer);
+    if (playerId > -1)
+    {
+        // most of the window arrived with the previous packets, the player skips those
+        auto &player = level->GetPlayer(playerId);
+        for (uint8_t i = 0; i < inputsWindow->count; ++i)
+            player->SendPlayerInput(inputsWindow->inputs[i]);
+
+        uint16_t &ack = peerSnapshotAcks[playerId];
+        if (Messages::RoomSnapshot::IsNewer(inputsWindow->lastSnapshot, ack))
+            ack = inputsWindow->lastSnapshot;
+    }
 }
 
 bool
@@ -169,53 +282,228 @@ GameRoom::Update()
     if (state != Playing)
         return false;
 
-    float newTimestamp = Core::Time::TimeServer::Instance()->GetSeconds();
-    float dt = newTimestamp - lastTimestamp;
-    if (dt <= .0f)
+    uint64_t newTimestamp = Core::Time::TimeServer::Instance()->GetNanoseconds();
+    if (newTimestamp <= lastTimestamp)
         return false;
 
+    uint64_t dt = newTimestamp - lastTimestamp;
     lastTimestamp = newTimestamp;
 
     accumulator += dt;
-    simTime += dt;
-    while (accumulator >= kServerFixedTime)
+    simTime += Core::Time::TimeServer::ToSeconds(dt);
+    while (accumulator >= kServerFixedNanoseconds)
     {
         //simTime += kServerFixedTime;
 
         simStep += kStepsCount;
         level->Update(simStep);
 
-        auto it = level->PlayersBegin(), end = level->PlayersEnd();
-        uint8_t playerId = 0;
-        for (; it != end; ++it, ++playerId)
-        {
-            if (!(*it)->HasChanged())
-                continue;
+        // every entity goes in, each peer gets what's in its interest as a delta against its baseline
+        snapshotSequence = Messages::RoomSnapshot::NextSequence(snapshotSequence);
+        auto &snapshot = snapshots.Next(snapshotSequence);
 
-            auto playerState = SmartPtr<Messages::PlayerState>::MakeNew<ScratchAllocator>();
+        uint8_t playersCount = level->PlayersEnd() - level->PlayersBegin();
+        for (uint8_t playerId = 0; playerId < playersCount; ++playerId)
+        {
+            auto &playerState = snapshot->AddPlayer();
             playerState->id = playerId;
-
-            (*it)->FillPlayerState(playerState);
-
-            ServerInstance::Instance()->Broadcast(peers, SmartPtr<Serializable>::CastFrom(playerState), HostInstance::Unsequenced, 0);
+            level->FillPlayerState(playerId, playerState);
         }
 
-        auto it2 = level->EnemiesBegin(), end2 = level->EnemiesEnd();
-        uint8_t enemyId = 0;
-        for (; it2 != end2; ++it2, ++enemyId)
+        uint8_t enemiesCount = level->EnemiesEnd() - level->EnemiesBegin();
+        for (uint8_t enemyId = 0; enemyId < enemiesCount; ++enemyId)
         {
-            auto enemyState = SmartPtr<Messages::EnemyState>::MakeNew<ScratchAllocator>();
+            auto &enemyState = snapshot->AddEnemy();
             enemyState->id = enemyId;
-            enemyState->step = simStep;
-            (*it2)->GetCurrentPosition(&enemyState->x, &enemyState->y);
-
-            ServerInstance::Instance()->Broadcast(peers, SmartPtr<Serializable>::CastFrom(enemyState), HostInstance::Unsequenced, 0);
+            level->FillEnemyState(enemyId, enemyState);
         }
 
-        accumulator -= kServerFixedTime;
+        this->UpdateInterests(snapshotSequence);
+
+        // one packet per step and peer for the whole room
+        this->QueueSnapshot(*snapshot);
+
+        accumulator -= kServerFixedNanoseconds;
     }
 
     return false;
 }
 
+void
+GameRoom::QueueSnapshot(Messages::RoomSnapshot &snapshot)
+{
+    enet_uint32 packetFlags = HostInstance::MessageTypeToFlags(HostInstance::Unsequenced);
+
+    // encode once per baseline and interest, peers that share both get the same bytes
+    uint32_t peersCount = peers.Count();
+    for (uint32_t i = 0; i < peersCount; ++i)
+    {
+        bool encoded = false;
+        for (uint32_t j = 0; j < i && !encoded; ++j)
+            encoded = this->SameEncoding(j, i, snapshot.sequence);
+        if (encoded)
+            continue;
+
+        const Messages::RoomSnapshot *baseline = snapshots.Find(peerSnapshotAcks[i]);
+        snapshot.baseline = baseline;
+        snapshot.interest = this->GetSentEntities(i, snapshot.sequence);
+        snapshot.baselineInterest = (baseline != nullptr ? this->GetSentEntities(i, baseline->sequence) : nullptr);
+
+        NetPatches patches;
+        snapshot.Serialize(sendStream, patches);
+
+        // without patches the group shares one packet
+        ENetPacket *sharedPacket = nullptr;
+        if (0 == patches.count)
+            sharedPacket = enet_packet_create(sendStream.GetData(), sendStream.GetSize(), packetFlags);
+
+        uint32_t groupCount = 0;
+        for (uint32_t j = i; j < peersCount; ++j)
+        {
+            if (j != i && !this->SameEncoding(i, j, snapshot.sequence))
+                continue;
+
+            ENetPacket *packet = sharedPacket;
+            if (nullptr == packet)
+            {
+                NetWriteStream::Patch(peers[j], sendStream, patches);
+                packet = enet_packet_create(sendStream.GetData(), sendStream.GetSize(), packetFlags);
+            }
+
+            outgoing.PushBack(OutgoingPacket(peers[j], packet, 0));
+            ++groupCount;
+        }
+
+        ServerInstance::Instance()->AddSnapshotStats(snapshot, groupCount);
+        ServerInstance::Instance()->GetNetStats().AddSent(snapshot.GetRTTI()->GetFCC(), (uint32_t)sendStream.GetSize(), groupCount);
+    }
+
+    snapshot.baseline = nullptr;
+    snapshot.interest = nullptr;
+    snapshot.baselineInterest = nullptr;
+}
+
+uint8_t*
+GameRoom::GetSentEntities(uint32_t peerIndex, uint16_t sequence)
+{
+    uint32_t row = peerIndex * Messages::RoomSnapshot::kHistorySize + sequence % Messages::RoomSnapshot::kHistorySize;
+    return peerSentEntities.Begin() + row * interestStride;
+}
+
+uint32_t
+GameRoom::GetSnapshotBudget(ENetPeer *peer) const
+{ // the least of what's configured, what the peer can take and its share of the host
+    uint32_t bandwidth = ServerInstance::Instance()->GetHostSettings().peerBandwidth;
+    if (peer->incomingBandwidth != 0 && (0 == bandwidth || peer->incomingBandwidth < bandwidth))
+        bandwidth = peer->incomingBandwidth;
+
+    ENetHost *host = peer->host;
+    if (host->outgoingBandwidth != 0 && host->connectedPeers > 0)
+    {
+        uint32_t share = host->outgoingBandwidth / (uint32_t)host->connectedPeers;
+        if (0 == bandwidth || share < bandwidth)
+            bandwidth = share;
+    }
+
+    if (0 == bandwidth)
+        return UINT32_MAX;
+
+    return (uint32_t)((float)bandwidth * kServerFixedTime) << 3;
+}
+
+void
+GameRoom::UpdateInterests(uint16_t sequence)
+{
+    uint32_t peersCount = peers.Count();
+    for (uint32_t i = 0; i < peersCount; ++i)
+    {
+        level->UpdateInterest(i, peerInterests.Begin() + i * interestStride, peerPriorities.Begin() + i * interestStride);
+        this->SelectEntities(i, sequence);
+    }
+}
+
+void
+GameRoom::SelectEntities(uint32_t peerIndex, uint16_t sequence)
+{
+    uint32_t playersCount = level->PlayersEnd() - level->PlayersBegin(),
+             entitiesCount = playersCount + (level->EnemiesEnd() - level->EnemiesBegin());
+
+    const uint8_t *interest = peerInterests.Begin() + peerIndex * interestStride;
+    float *priorities = peerPriorities.Begin() + peerIndex * interestStride;
+    uint8_t *sent = this->GetSentEntities(peerIndex, sequence);
+
+    uint32_t orderedCount = 0;
+    for (uint32_t i = 0; i < entitiesCount; ++i)
+    {
+        sent[i] = 0;
+        if (interest[i])
+            sendOrder[orderedCount++] = (uint16_t)i;
+    }
+
+    // entities left out keep their priority and come first next step, that's how the room degrades
+    std::sort(sendOrder.Begin(), sendOrder.Begin() + orderedCount, [priorities](uint16_t a, uint16_t b)
+    {
+        return priorities[a] > priorities[b];
+    });
+
+    uint32_t budget = this->GetSnapshotBudget(peers[peerIndex]),
+             bits = kSnapshotHeaderBits + entitiesCount; // a relevance bit each
+    for (uint32_t i = 0; i < orderedCount; ++i)
+    {
+        uint16_t entity = sendOrder[i];
+
+        // priced whole, the delta against the baseline only makes it cheaper.
+        // The first one goes anyway, a budget under one entity would starve it.
+        uint32_t entityBits = (entity < playersCount ? Messages::RoomSnapshot::PlayerStateBits() : Messages::RoomSnapshot::EnemyStateBits());
+        if (i > 0 && bits + entityBits > budget)
+            continue;
+
+        bits += entityBits;
+        sent[entity] = 1;
+        priorities[entity] = .0f;
+    }
+}
+
+void
+GameRoom::ResetInterests()
+{
+    for (auto it = peerInterests.Begin(), end = peerInterests.End(); it != end; ++it)
+        *it = 0;
+    for (auto it = peerPriorities.Begin(), end = peerPriorities.End(); it != end; ++it)
+        *it = .0f;
+    for (auto it = peerSentEntities.Begin(), end = peerSentEntities.End(); it != end; ++it)
+        *it = 0;
+}
+
+bool
+GameRoom::SameEncoding(uint32_t peerIndex, uint32_t otherIndex, uint16_t sequence)
+{
+    const Messages::RoomSnapshot *baseline = snapshots.Find(peerSnapshotAcks[peerIndex]);
+    if (snapshots.Find(peerSnapshotAcks[otherIndex]) != baseline)
+        return false;
+
+    if (memcmp(this->GetSentEntities(peerIndex, sequence), this->GetSentEntities(otherIndex, sequence), interestStride) != 0)
+        return false;
+
+    return nullptr == baseline ||
+           0 == memcmp(this->GetSentEntities(peerIndex, baseline->sequence), this->GetSentEntities(otherIndex, baseline->sequence), interestStride);
+}
+
+void
+GameRoom::FlushOutgoing()
+{
+    auto it = outgoing.Begin(), end = outgoing.End();
+    for (; it != end; ++it)
+    {
+        enet_peer_send(it->peer, it->channel, it->packet);
+
+        // once its last peer had it, a packet nobody took is ours to free
+        bool last = (it + 1 == end || (it + 1)->packet != it->packet);
+        if (last && 0 == it->packet->referenceCount)
+            enet_packet_destroy(it->packet);
+    }
+
+    outgoing.Clear();
+}
+
 }; // namespace Network
@@ -6,8 +6,13 @@
 #include "Core/SmartPtr.h"
 #include "Core/Pool/BaseObject.h"
 #include "Core/Collections/Array_type.h"
+#include "Core/IO/BitStream.h"
+#include "Core/Memory/ArenaAllocator.h"
+#include "Core/Time/TimeServer.h"
 #include "Network/Messages/StartGame.h"
 #include "Network/Messages/PlayerInputs.h"
+#include "Network/Messages/PlayerInputsWindow.h"
+#include "Network/Messages/RoomSnapshot.h"
 #include "Game/Level.h"
 #include "Network/HostInstance.h"
 #include "Network/GameRoomData.h"
@@ -26,35 +31,100 @@ public:
         Playing
     };
 protected:
+    struct OutgoingPacket
+    {
+        ENetPeer *peer;
+        ENetPacket *packet;
+        uint8_t channel;
+
+        OutgoingPacket()
+        { }
+
+        OutgoingPacket(ENetPeer *_peer, ENetPacket *_packet, uint8_t _channel)
+        : peer(_peer), packet(_packet), channel(_channel)
+        { }
+    };
+
     float lifeTime;
     State state;
+    uint32_t openSlot; // in the server's OpenRooms while joinable
 
     Array<ENetPeer*> peers;
     Array<SmartPtr<Messages::StartGame>> startGameMsgs;
 
-    float lastTimestamp;
-    float accumulator, simTime;
+    uint64_t lastTimestamp, accumulator; // ns, exact however long the server is up
+    float simTime;
     uint32_t simStep;
+    uint32_t stepPhase; // taken from the server while playing
 
     SmartPtr<GameRoomData> data;
+
+    // the level and its entities, released with the room in one go
+    Core::Memory::ArenaAllocator *arena;
     SmartPtr<Game::Level> level;
+
+    Messages::RoomSnapshotHistory snapshots;
+    uint16_t snapshotSequence;
+    Array<uint16_t> peerSnapshotAcks; // by player, as peers
+
+    // Level::UpdateInterest flags and priorities by peer, interestStride entities each
+    Array<uint8_t> peerInterests;
+    Array<float> peerPriorities;
+    uint32_t interestStride;
+
+    // By peer and history slot, the entities each snapshot carried to each peer: those in its interest
+    // that fit its bandwidth budget. The acknowledged row tells what the peer's baseline holds.
+    Array<uint8_t> peerSentEntities;
+    Array<uint16_t> sendOrder;
+
+    Core::IO::BitStream sendStream;
+    Array<OutgoingPacket> outgoing; // the peers sharing a packet are next to each other
+
+    void QueueSnapshot(Messages::RoomSnapshot &snapshot);
+
+    uint8_t* GetSentEntities(uint32_t peerIndex, uint16_t sequence);
+    uint32_t GetSnapshotBudget(ENetPeer *peer) const;
+    void UpdateInterests(uint16_t sequence);
+    void SelectEntities(uint32_t peerIndex, uint16_t sequence);
+    void ResetInterests();
+    bool SameEncoding(uint32_t peerIndex, uint32_t otherIndex, uint16_t sequence);
 public:
-    const int kStepsCount = 3;
-    const float kServerFixedTime = (float)kStepsCount * HostInstance::kFixedTimeStep;
+    static const uint32_t kSnapshotHeaderBits = 72; // FCC, sequence, baseline and counts
+
+    static const size_t kArenaChunkSize = 16 * 1024;
+
+    static constexpr int kStepsCount = 3;
+    static constexpr float kServerFixedTime = (float)kStepsCount * HostInstance::kFixedTimeStep;
+    static constexpr uint64_t kServerFixedNanoseconds = Core::Time::TimeServer::FromSeconds(kServerFixedTime);
 
     GameRoom(uint8_t playersCount);
+    GameRoom(const GameRoom &other) = delete;
+    // the rooms pool moves rooms around as it grows and frees, that must keep their pool and id
+    GameRoom(GameRoom &&other);
     virtual ~GameRoom();
 
     State GetState() const;
     const SmartPtr<GameRoomData>& GetData() const;
+    uint64_t GetNextStepTime() const; // ns
+    uint8_t GetPlayersCount() const;
+    uint8_t GetJoinedCount() const;
+    // bytes the room's arena took, the match's memory footprint
+    size_t GetArenaSize() const;
+
+    uint32_t GetOpenSlot() const;
+    void SetOpenSlot(uint32_t slot);
 
     void AddPlayer(ENetPeer *peer);
     bool PlayerReady(ENetPeer *peer, const SmartPtr<Messages::StartGame> &startGame);
     bool PlayerLeft(ENetPeer *peer);
 
     void RecvPlayerInputs(ENetPeer *peer, const SmartPtr<Messages::PlayerInputs> &playerInputs);
+    void RecvPlayerInputs(ENetPeer *peer, const SmartPtr<Messages::PlayerInputsWindow> &inputsWindow);
 
+    // Runs as a job, concurrently with other rooms: it must not touch the ENet host,
+    // the garbage collector or any allocator that isn't thread-safe.
     bool Update();
+    void FlushOutgoing();
 };
 
 inline GameRoom::State
@@ -69,4 +139,41 @@ GameRoom::GetData() const
     return data;
 }
 
+inline uint8_t
+GameRoom::GetPlayersCount() const
+{
+    return (uint8_t)data->playersData.Count();
+}
+
+inline uint8_t
+GameRoom::GetJoinedCount() const
+{
+    return (uint8_t)peers.Count();
+}
+
+inline size_t
+GameRoom::GetArenaSize() const
+{
+    return arena->GetTotalReserved();
+}
+
+inline uint32_t
+GameRoom::GetOpenSlot() const
+{
+    return openSlot;
+}
+
+inline void
+GameRoom::SetOpenSlot(uint32_t slot)
+{
+    openSlot = slot;
+}
+
+inline uint64_t
+GameRoom::GetNextStepTime() const
+{
+    assert(Playing == state);
+    return lastTimestamp + kServerFixedNanoseconds - accumulator;
+}
+
 }; // namespace Network
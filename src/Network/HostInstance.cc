@@ -1,4 +1,6 @@
+#include <algorithm>
 #include "Network/HostInstance.h"
+#include "Network/FastLZ.h"
 #include "Core/Memory/MallocAllocator.h"
 #include "Core/Memory/LinearAllocator.h"
 #include "Core/Memory/BlocksAllocator.h"
@@ -12,7 +14,7 @@ namespace Network {
 
 HostInstance *HostInstance::instance = nullptr;
 
-const float HostInstance::kFixedTimeStep = 0.016f;
+constexpr float HostInstance::kFixedTimeStep;
 
 enet_uint32
 HostInstance::MessageTypeToFlags(MessageType messageType)
@@ -32,11 +34,68 @@ HostInstance::MessageTypeToFlags(MessageType messageType)
     return packetFlags;
 }
 
+bool
+HostInstance::SetCompressor(ENetHost *host, Compressor compressor)
+{
+    switch (compressor)
+    {
+    case NoCompressor:
+        enet_host_compress(host, nullptr);
+        return true;
+    case RangeCoderCompressor:
+        return 0 == enet_host_compress_with_range_coder(host);
+    case FastLZCompressor:
+        return FastLZ::SetOnHost(host);
+    default:
+        return false;
+    }
+}
+
+static const char *compressorNames[HostInstance::CompressorsCount] = { "none", "range", "lz" };
+
+const char*
+HostInstance::GetCompressorName(Compressor compressor)
+{
+    assert(compressor < CompressorsCount);
+    return compressorNames[compressor];
+}
+
+bool
+HostInstance::FindCompressor(const char *name, Compressor *compressor)
+{
+    for (uint32_t i = 0; i < CompressorsCount; ++i)
+    {
+        if (0 == strcmp(name, compressorNames[i]))
+        {
+            *compressor = (Compressor)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+HostInstance::HostSettings::HostSettings()
+: peersCount(kDefaultPeersCount),
+  channelsCount(kMinChannelsCount),
+  incomingBandwidth(0),
+  outgoingBandwidth(0),
+  peerBandwidth(0),
+  compressor(RangeCoderCompressor)
+{ }
+
 HostInstance::HostInstance()
 : host(nullptr),
+  shared(instance != nullptr),
   managers(GetAllocator<MallocAllocator>())
 {
-    assert(nullptr == instance);
+    if (shared)
+    {
+        log = instance->log;
+        stringsTable = instance->stringsTable;
+        timeServer = instance->timeServer;
+        return;
+    }
+
     instance = this;
 
     log = SmartPtr<Core::Log>::MakeNew<LinearAllocator>();
@@ -48,12 +107,25 @@ HostInstance::HostInstance()
 
 HostInstance::~HostInstance()
 {
+    if (shared)
+        return;
+
     assert(this == instance);
     instance = nullptr;
 }
 
+void
+HostInstance::SetHostSettings(const HostSettings &settings)
+{
+    assert(nullptr == host);
+
+    hostSettings = settings;
+    hostSettings.peersCount = std::max(1u, std::min(hostSettings.peersCount, (uint32_t)ENET_PROTOCOL_MAXIMUM_PEER_ID));
+    hostSettings.channelsCount = std::max((uint32_t)kMinChannelsCount, std::min(hostSettings.channelsCount, (uint32_t)ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT));
+}
+
 bool
-HostInstance::StartServer(int port)
+HostInstance::InitializeENet()
 {
     //ClassInfoUtils::Instance()->Initialize();
 
@@ -63,17 +135,56 @@ HostInstance::StartServer(int port)
     callbacks.free = [](void *ptr) { return Memory::GetAllocator<MallocAllocator>().Free(ptr); };
     callbacks.time_get = [](void) { return Core::Time::TimeServer::Instance()->GetMilliseconds(); };
 
-    if (0 == enet_initialize_with_callbacks(ENET_VERSION, &callbacks))
+    return 0 == enet_initialize_with_callbacks(ENET_VERSION, &callbacks);
+}
+
+ENetHost*
+HostInstance::CreateServerHost(int port, bool reusePort)
+{
+    ENetAddress address;
+    address.host = ENET_HOST_ANY;
+    address.port = port;
+
+    ENetHost *newHost;
+    if (reusePort)
+    { // create it unbound, SO_REUSEPORT has to be set before binding
+        newHost = enet_host_create(nullptr, hostSettings.peersCount, hostSettings.channelsCount, hostSettings.incomingBandwidth, hostSettings.outgoingBandwidth);
+        if (nullptr == newHost)
+            return nullptr;
+
+        if (enet_socket_set_option(newHost->socket, ENET_SOCKOPT_REUSEPORT, 1) != 0 ||
+            enet_socket_bind(newHost->socket, &address) != 0)
+        {
+            enet_host_destroy(newHost);
+            return nullptr;
+        }
+
+        if (enet_socket_get_address(newHost->socket, &newHost->address) != 0)
+            newHost->address = address;
+    }
+    else
     {
-        ENetAddress address;
-        address.host = ENET_HOST_ANY;
-        address.port = port;
+        newHost = enet_host_create(&address, hostSettings.peersCount, hostSettings.channelsCount, hostSettings.incomingBandwidth, hostSettings.outgoingBandwidth);
+        if (nullptr == newHost)
+            return nullptr;
+    }
 
-        host = enet_host_create(&address, 8, 2, 0, 0);
-        if (nullptr == host)
-            return false;
+    if (!SetCompressor(newHost, hostSettings.compressor))
+    {
+        enet_host_destroy(newHost);
+        return nullptr;
+    }
+
+    return newHost;
+}
 
-        if (enet_host_compress_with_range_coder(host) != 0)
+bool
+HostInstance::StartServer(int port)
+{
+    if (this->InitializeENet())
+    {
+        host = this->CreateServerHost(port, false);
+        if (nullptr == host)
             return false;
     }
 
@@ -83,29 +194,25 @@ HostInstance::StartServer(int port)
 bool
 HostInstance::Connect(const char *serverHost, int serverPort)
 {
-    //ClassInfoUtils::Instance()->Initialize();
-
-    ENetCallbacks callbacks;
-    Memory::Zero(&callbacks);
-    callbacks.malloc = [](size_t sz) { return Memory::GetAllocator<MallocAllocator>().Allocate(sz, 4); };
-    callbacks.free = [](void *ptr) { return Memory::GetAllocator<MallocAllocator>().Free(ptr); };
-    callbacks.time_get = [](void) { return Core::Time::TimeServer::Instance()->GetMilliseconds(); };
-
-    if (0 == enet_initialize_with_callbacks(ENET_VERSION, &callbacks))
+    if (this->InitializeENet())
     {
         ENetAddress address;
 
-        host = enet_host_create(nullptr, 1, 2, 0, 0);
+        host = enet_host_create(nullptr, 1, hostSettings.channelsCount, hostSettings.incomingBandwidth, hostSettings.outgoingBandwidth);
         if (nullptr == host)
             return false;
 
-        if (enet_host_compress_with_range_coder(host) != 0)
+        if (!SetCompressor(host, hostSettings.compressor))
+        {
+            enet_host_destroy(host);
+            host = nullptr;
             return false;
+        }
 
         enet_address_set_host(&address, serverHost);
         address.port = serverPort;
 
-        enet_host_connect(host, &address, 2, 0);
+        enet_host_connect(host, &address, hostSettings.channelsCount, 0);
 
         //timeServer->Resume();
 
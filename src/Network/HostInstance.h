@@ -20,10 +20,35 @@ public:
         Sequenced,
         Unsequenced
     };
+
+    // What the hosts compress packets with, both ends of a connection have to agree
+    enum Compressor
+    {
+        NoCompressor = 0,
+        RangeCoderCompressor,   // ENet's, the smallest packets and the most CPU
+        FastLZCompressor,       // see FastLZ
+
+        CompressorsCount
+    };
+
+    // Limits of the ENet hosts created by the instance, set them before starting
+    struct HostSettings
+    {
+        uint32_t peersCount;        // per host, up to ENET_PROTOCOL_MAXIMUM_PEER_ID
+        uint32_t channelsCount;
+        uint32_t incomingBandwidth; // bytes/s, 0 is unlimited
+        uint32_t outgoingBandwidth; // bytes/s, 0 is unlimited
+        uint32_t peerBandwidth;     // bytes/s of room snapshots per peer, 0 leaves it to the two above
+        Compressor compressor;
+
+        HostSettings();
+    };
 protected:
     static HostInstance *instance;
 
     ENetHost *host;
+    HostSettings hostSettings;
+    bool shared; // made while another instance lives, it runs on that one's log, time and strings
 
     SmartPtr<Core::Log> log;
     SmartPtr<Core::Time::TimeServer> timeServer;
@@ -31,22 +56,43 @@ protected:
 
     Array<SmartPtr<Managers::BaseManager>> managers;
 
-    enet_uint32 MessageTypeToFlags(MessageType messageType);
+    bool InitializeENet();
+    ENetHost* CreateServerHost(int port, bool reusePort);
 
     bool StartServer(int port);
     bool Connect(const char *serverHost, int serverPort);
     void Stop();
 public:
-    static const float kFixedTimeStep;
+    static constexpr float kFixedTimeStep = 0.016f;
 
+    static const uint32_t kDefaultPeersCount = 1024;
+    static const uint32_t kMinChannelsCount = 2; // 0 for game state, 1 for rooms management
+
+    // the first instance of the process is Instance(), later ones share its singletons
+    // and leave ticking the time to it, like headless clients next to a server in a load test
     HostInstance();
     virtual ~HostInstance();
 
+    const HostSettings& GetHostSettings() const;
+    void SetHostSettings(const HostSettings &settings);
+
     const SmartPtr<Managers::BaseManager>& GetManager(const Core::ClassInfo *classInfo);
 
+    static enet_uint32 MessageTypeToFlags(MessageType messageType);
+
+    static bool SetCompressor(ENetHost *host, Compressor compressor);
+    static const char* GetCompressorName(Compressor compressor);
+    static bool FindCompressor(const char *name, Compressor *compressor);
+
     static HostInstance* Instance();
 };
 
+inline const HostInstance::HostSettings&
+HostInstance::GetHostSettings() const
+{
+    return hostSettings;
+}
+
 inline HostInstance*
 HostInstance::Instance()
 {
@@ -0,0 +1,190 @@
+#pragma once
+
+#define NOMINMAX
+#include "enet/enet.h"
+
+#include "Core/Debug.h"
+#include "Core/SmartPtr.h"
+#include "Core/ClassInfo.h"
+#include "Core/RefCountedPool.h"
+#include "Core/IO/BitStream.h"
+#include "Core/Memory/Memory.h"
+#include "Core/Memory/MallocAllocator.h"
+#include "Core/Memory/BlocksAllocator.h"
+#include "Network/Serializable.h"
+
+namespace Network {
+
+// Maps message FCCs to typed handlers of Owner, registered once at startup.
+// Receiving finds the entry in a small open addressed table and makes one call through it,
+// no class hash lookup and no IsInstanceOf chain. Messages come from a pool per class,
+// they go back to it when the handler and whoever it passed them to let them go.
+template <typename Owner, typename Context>
+class MessageDispatcher {
+protected:
+    typedef void (*Invoke)(Owner *owner, const Context &context, const SmartPtr<Serializable> &message);
+    typedef void (*Prepare)(Owner *owner, Serializable *message);
+
+    static const uint32_t kMaxMessages = 32;
+    static const uint32_t kSlotsBits = 6; // twice the entries keeps probing short
+    static const uint32_t kSlotsCount = 1 << kSlotsBits;
+    static const uint8_t kEmptySlot = 0xff;
+
+    struct Entry
+    {
+        uint32_t fcc;
+        Core::RefCountedPool *pool;
+        Prepare prepare;
+        Invoke invoke;
+    };
+
+    Entry entries[kMaxMessages];
+    uint32_t entriesCount;
+
+    uint8_t slots[kSlotsCount];
+
+    static uint32_t Slot(uint32_t fcc);
+
+    template <typename T, void (Owner::*Handler)(const Context&, const SmartPtr<T>&)>
+    static void InvokeHandler(Owner *owner, const Context &context, const SmartPtr<Serializable> &message);
+
+    template <typename T, void (Owner::*Setup)(T*)>
+    static void PrepareMessage(Owner *owner, Serializable *message);
+
+    void AddEntry(const Core::ClassInfo *classInfo, Prepare prepare, Invoke invoke);
+    const Entry* FindEntry(uint32_t fcc) const;
+public:
+    MessageDispatcher();
+    MessageDispatcher(const MessageDispatcher &other) = delete;
+    ~MessageDispatcher();
+
+    MessageDispatcher& operator =(const MessageDispatcher &other) = delete;
+
+    template <typename T, void (Owner::*Handler)(const Context&, const SmartPtr<T>&)>
+    void Register();
+
+    // Setup runs on the new message before it gets deserialized
+    template <typename T, void (Owner::*Setup)(T*), void (Owner::*Handler)(const Context&, const SmartPtr<T>&)>
+    void Register();
+
+    // false if data doesn't start with the FCC of a registered message
+    bool Dispatch(Owner *owner, const Context &context, ENetPeer *peer, Core::IO::BitStream &data) const;
+};
+
+template <typename Owner, typename Context>
+MessageDispatcher<Owner, Context>::MessageDispatcher()
+: entriesCount(0)
+{
+    for (uint32_t i = 0; i < kSlotsCount; ++i)
+        slots[i] = kEmptySlot;
+}
+
+template <typename Owner, typename Context>
+MessageDispatcher<Owner, Context>::~MessageDispatcher()
+{
+    for (uint32_t i = 0; i < entriesCount; ++i)
+        Core::Memory::Delete<Core::Memory::MallocAllocator>(entries[i].pool);
+}
+
+template <typename Owner, typename Context>
+inline uint32_t
+MessageDispatcher<Owner, Context>::Slot(uint32_t fcc)
+{ // FCCs are four characters, mix them before masking
+    return (fcc * 0x9e3779b1u) >> (32 - kSlotsBits);
+}
+
+template <typename Owner, typename Context>
+template <typename T, void (Owner::*Handler)(const Context&, const SmartPtr<T>&)>
+void
+MessageDispatcher<Owner, Context>::InvokeHandler(Owner *owner, const Context &context, const SmartPtr<Serializable> &message)
+{
+    (owner->*Handler)(context, SmartPtr<T>::CastFrom(message));
+}
+
+template <typename Owner, typename Context>
+template <typename T, void (Owner::*Setup)(T*)>
+void
+MessageDispatcher<Owner, Context>::PrepareMessage(Owner *owner, Serializable *message)
+{
+    (owner->*Setup)(static_cast<T*>(message));
+}
+
+template <typename Owner, typename Context>
+void
+MessageDispatcher<Owner, Context>::AddEntry(const Core::ClassInfo *classInfo, Prepare prepare, Invoke invoke)
+{
+    assert(classInfo->HasFCC() && classInfo->IsDerivedFrom(&Serializable::RTTI));
+    assert(nullptr == this->FindEntry(classInfo->GetFCC()));
+    assert(entriesCount < kMaxMessages);
+
+    Entry &entry = entries[entriesCount];
+    entry.fcc = classInfo->GetFCC();
+    entry.pool = Core::Memory::New<Core::Memory::MallocAllocator, Core::RefCountedPool>(classInfo, &Core::Memory::GetAllocator<Core::Memory::BlocksAllocator>());
+    entry.prepare = prepare;
+    entry.invoke = invoke;
+
+    uint32_t slot = Slot(entry.fcc);
+    while (slots[slot] != kEmptySlot)
+        slot = (slot + 1) & (kSlotsCount - 1);
+
+    slots[slot] = (uint8_t)entriesCount++;
+}
+
+template <typename Owner, typename Context>
+inline const typename MessageDispatcher<Owner, Context>::Entry*
+MessageDispatcher<Owner, Context>::FindEntry(uint32_t fcc) const
+{
+    uint32_t slot = Slot(fcc);
+    while (slots[slot] != kEmptySlot)
+    {
+        const Entry &entry = entries[slots[slot]];
+        if (entry.fcc == fcc)
+            return &entry;
+
+        slot = (slot + 1) & (kSlotsCount - 1);
+    }
+
+    return nullptr;
+}
+
+template <typename Owner, typename Context>
+template <typename T, void (Owner::*Handler)(const Context&, const SmartPtr<T>&)>
+void
+MessageDispatcher<Owner, Context>::Register()
+{
+    this->AddEntry(&T::RTTI, nullptr, &InvokeHandler<T, Handler>);
+}
+
+template <typename Owner, typename Context>
+template <typename T, void (Owner::*Setup)(T*), void (Owner::*Handler)(const Context&, const SmartPtr<T>&)>
+void
+MessageDispatcher<Owner, Context>::Register()
+{
+    this->AddEntry(&T::RTTI, &PrepareMessage<T, Setup>, &InvokeHandler<T, Handler>);
+}
+
+template <typename Owner, typename Context>
+bool
+MessageDispatcher<Owner, Context>::Dispatch(Owner *owner, const Context &context, ENetPeer *peer, Core::IO::BitStream &data) const
+{
+    if (data.RemainingBits() < 32)
+        return false;
+
+    uint32_t fcc;
+    data >> fcc;
+
+    const Entry *entry = this->FindEntry(fcc);
+    if (nullptr == entry)
+        return false;
+
+    auto message = SmartPtr<Serializable>::CastFrom(entry->pool->Acquire());
+    if (entry->prepare != nullptr)
+        entry->prepare(owner, message.Get());
+
+    message->Deserialize(peer, data);
+
+    entry->invoke(owner, context, message);
+    return true;
+}
+
+}; // namespace Network
@@ -13,13 +13,15 @@ protected:
     {
         stream.Serialize(id);
         stream.Serialize(step);
-        stream.Serialize(x);
-        stream.Serialize(y);
+        stream.SerializeQuantizedFloat(x, -kPositionBound, kPositionBound, kPositionPrecision);
+        stream.SerializeQuantizedFloat(y, -kPositionBound, kPositionBound, kPositionPrecision);
+        stream.SerializeBits(health, kHealthBits);
     }
 public:
     uint8_t id;
     uint32_t step;
     float x, y;
+    uint8_t health;
 
     EnemyState();
     EnemyState(const EnemyState &other) = delete;
@@ -13,5 +13,11 @@ JoinRoom::JoinRoom()
 JoinRoom::~JoinRoom()
 { }
 
+void
+JoinRoom::OnRecycle()
+{
+    roomData.Reset();
+}
+
     } // namespace Messages
 } // namespace Network
@@ -48,6 +48,8 @@ public:
     virtual ~JoinRoom();
 
     JoinRoom& operator =(const JoinRoom &other) = delete;
+protected:
+    virtual void OnRecycle();
 };
 
     } // namespace Messages
@@ -12,5 +12,12 @@ PlayerInputs::PlayerInputs()
 PlayerInputs::~PlayerInputs()
 { }
 
+void
+PlayerInputs::Quantize()
+{
+    x = NetWriteStream::Quantize(x, -1.0f, 1.0f, kInputPrecision);
+    y = NetWriteStream::Quantize(y, -1.0f, 1.0f, kInputPrecision);
+}
+
     } // namespace Messages
 } // namespace Network
@@ -12,20 +12,25 @@ protected:
     template <typename Stream> void SerializeImpl(Stream &stream)
     {
         stream.Serialize(step);
-        stream.Serialize(x);
-        stream.Serialize(y);
+        stream.SerializeQuantizedFloat(x, -1.0f, 1.0f, kInputPrecision);
+        stream.SerializeQuantizedFloat(y, -1.0f, 1.0f, kInputPrecision);
         stream.Serialize(attack);
+        stream.Serialize(lastSnapshot);
     }
 public:
     uint32_t step;
     float x, y;
     bool attack;
+    uint16_t lastSnapshot; // newest RoomSnapshot received, the server's next baseline
 
     PlayerInputs();
     PlayerInputs(const PlayerInputs &other) = delete;
     virtual ~PlayerInputs();
 
     PlayerInputs& operator =(const PlayerInputs &other) = delete;
+
+    // rounds the axes as the server will get them, so that the sender predicts with the same inputs
+    void Quantize();
 };
 
     } // namespace Messages
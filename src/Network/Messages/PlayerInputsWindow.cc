@@ -0,0 +1,57 @@
+#include "Network/Messages/PlayerInputsWindow.h"
+
+namespace Network {
+    namespace Messages {
+
+DefineClassInfoWithFactoryAndFCC(Network::Messages::PlayerInputsWindow, 'PLIW', Network::Serializable);
+DefineSerializable(Network::Messages::PlayerInputsWindow);
+
+PlayerInputsWindow::PlayerInputsWindow()
+: count(0),
+  lastSnapshot(0)
+{ }
+
+PlayerInputsWindow::~PlayerInputsWindow()
+{ }
+
+void
+PlayerInputsWindow::OnRecycle()
+{
+    this->Clear();
+}
+
+const Game::Player::Input&
+PlayerInputsWindow::Push(uint32_t step, float x, float y, bool attack)
+{
+    assert(0 == count || step >= inputs[0].step);
+
+    uint8_t keptCount = 0;
+    if (count > 0 && step == inputs[0].step)
+        keptCount = count - 1; // sent again within the same step, the last one counts
+    else if (count > 0 && step - inputs[0].step <= kMaxStepGap)
+    { // older inputs are kept only if they can still be coded against the new one
+        keptCount = (count < kWindowSize ? count : kWindowSize - 1);
+
+        for (uint8_t i = keptCount; i > 0; --i)
+            inputs[i] = inputs[i - 1];
+    }
+
+    Game::Player::Input &input = inputs[0];
+    input.step = step;
+    input.x = NetWriteStream::Quantize(x, -1.0f, 1.0f, kInputPrecision);
+    input.y = NetWriteStream::Quantize(y, -1.0f, 1.0f, kInputPrecision);
+    input.attack = attack;
+
+    count = keptCount + 1;
+    return input;
+}
+
+void
+PlayerInputsWindow::Clear()
+{
+    count = 0;
+    lastSnapshot = 0;
+}
+
+    } // namespace Messages
+} // namespace Network
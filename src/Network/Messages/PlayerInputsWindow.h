@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Network/Serializable.h"
+#include "Game/Player.h"
+
+namespace Network {
+    namespace Messages {
+
+// The last kWindowSize inputs of a player, newest first, sent every step in place of PlayerInputs:
+// the server gets an input lost on the way with any of the next packets.
+// Older inputs are coded against the newer next to them, usually one step before with the same axes.
+class PlayerInputsWindow : public Network::Serializable {
+    DeclareClassInfo;
+    DeclareSerializable;
+protected:
+    template <typename Stream> void SerializeInput(Stream &stream, Game::Player::Input &input, const Game::Player::Input &newer)
+    {
+        uint32_t stepGap = newer.step - input.step;
+        stream.SerializeRangedInt(stepGap, 1, kMaxStepGap);
+        input.step = newer.step - stepGap;
+
+        bool sameAxes = (Stream::IsWriting && input.x == newer.x && input.y == newer.y);
+        stream.Serialize(sameAxes);
+        if (sameAxes)
+        {
+            input.x = newer.x;
+            input.y = newer.y;
+        }
+        else
+        {
+            stream.SerializeQuantizedFloat(input.x, -1.0f, 1.0f, kInputPrecision);
+            stream.SerializeQuantizedFloat(input.y, -1.0f, 1.0f, kInputPrecision);
+        }
+
+        stream.Serialize(input.attack);
+    }
+
+    template <typename Stream> void SerializeImpl(Stream &stream)
+    {
+        if (!stream.SerializeRangedInt(count, 1, kWindowSize))
+        {
+            count = 0;
+            return;
+        }
+
+        stream.Serialize(lastSnapshot);
+
+        Game::Player::Input &newest = inputs[0];
+        stream.Serialize(newest.step);
+        stream.SerializeQuantizedFloat(newest.x, -1.0f, 1.0f, kInputPrecision);
+        stream.SerializeQuantizedFloat(newest.y, -1.0f, 1.0f, kInputPrecision);
+        stream.Serialize(newest.attack);
+
+        for (uint8_t i = 1; i < count; ++i)
+            this->SerializeInput(stream, inputs[i], inputs[i - 1]);
+    }
+public:
+    static const uint32_t kWindowSize = 8;  // 128ms of inputs at the client's fixed step
+    static const uint32_t kMaxStepGap = 16; // an input further behind the newer one drops out
+
+    uint8_t count;
+    Game::Player::Input inputs[kWindowSize];
+    uint16_t lastSnapshot; // newest RoomSnapshot received, the server's next baseline
+
+    PlayerInputsWindow();
+    PlayerInputsWindow(const PlayerInputsWindow &other) = delete;
+    virtual ~PlayerInputsWindow();
+
+    PlayerInputsWindow& operator =(const PlayerInputsWindow &other) = delete;
+
+    // Adds the newest input with its axes rounded as the server will get them,
+    // the sender predicts with what it returns.
+    const Game::Player::Input& Push(uint32_t step, float x, float y, bool attack);
+    void Clear();
+protected:
+    virtual void OnRecycle();
+};
+
+    } // namespace Messages
+} // namespace Network
@@ -14,11 +14,10 @@ protected:
     {
         stream.Serialize(id);
         stream.Serialize(step);
-        stream.Serialize(x);
-        stream.Serialize(y);
-        stream.SerializeHalfFloat(dx);
-        stream.SerializeHalfFloat(dy);
-        stream.Serialize(actionState);
+        stream.SerializeQuantizedFloat(x, -kPositionBound, kPositionBound, kPositionPrecision);
+        stream.SerializeQuantizedFloat(y, -kPositionBound, kPositionBound, kPositionPrecision);
+        stream.SerializeDirection(dx, dy, kDirectionBits);
+        stream.SerializeBits(actionState, kActionStateBits);
         stream.Serialize(actionStep);
     }
 public:
@@ -0,0 +1,17 @@
+#include "Network/Messages/QuickJoin.h"
+#include "Core/Collections/Array.h"
+
+namespace Network {
+    namespace Messages {
+
+DefineClassInfoWithFactoryAndFCC(Network::Messages::QuickJoin, 'QJRM', Network::Messages::JoinRoom);
+DefineSerializable(Network::Messages::QuickJoin);
+
+QuickJoin::QuickJoin()
+{ }
+
+QuickJoin::~QuickJoin()
+{ }
+
+    } // namespace Messages
+} // namespace Network
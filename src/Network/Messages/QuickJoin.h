@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Network/Messages/JoinRoom.h"
+
+namespace Network {
+    namespace Messages {
+
+// Asks to be placed in any room for playersCount players, the server answers with the joined room
+// as JoinRoom would, making one if none is open.
+class QuickJoin : public JoinRoom {
+    DeclareClassInfo;
+    DeclareSerializable;
+protected:
+    template <typename Stream> void SerializeImpl(Stream &stream)
+    {
+        stream.Serialize(playersCount);
+        JoinRoom::SerializeImpl(stream);
+    }
+public:
+    uint8_t playersCount;
+
+    QuickJoin();
+    QuickJoin(const QuickJoin &other) = delete;
+    virtual ~QuickJoin();
+
+    QuickJoin& operator =(const QuickJoin &other) = delete;
+};
+
+    } // namespace Messages
+} // namespace Network
@@ -0,0 +1,220 @@
+#include "Network/Messages/RoomSnapshot.h"
+#include "Core/Collections/Array.h"
+#include "Core/Memory/MallocAllocator.h"
+
+using namespace Core::Memory;
+
+namespace Network {
+    namespace Messages {
+
+DefineClassInfoWithFactoryAndFCC(Network::Messages::RoomSnapshot, 'RMSN', Network::Serializable);
+DefineSerializable(Network::Messages::RoomSnapshot);
+
+RoomSnapshot::RoomSnapshot()
+: sequence(0),
+  playersCount(0),
+  enemiesCount(0),
+  players(GetAllocator<MallocAllocator>()),
+  enemies(GetAllocator<MallocAllocator>()),
+  playersChanged(GetAllocator<MallocAllocator>()),
+  enemiesChanged(GetAllocator<MallocAllocator>()),
+  relevant(GetAllocator<MallocAllocator>()),
+  baseline(nullptr),
+  interest(nullptr),
+  baselineInterest(nullptr),
+  history(nullptr),
+  complete(true)
+{
+    for (uint32_t i = 0; i < EntityTypesCount; ++i)
+        writtenBits[i] = fullBits[i] = 0;
+}
+
+RoomSnapshot::~RoomSnapshot()
+{ }
+
+void
+RoomSnapshot::OnRecycle()
+{ // entity states stay, the next decode reuses them
+    this->Clear();
+    history = nullptr;
+    complete = true;
+}
+
+uint32_t
+RoomSnapshot::PlayerStateBits()
+{
+    return ((sizeof(PlayerState::id) + sizeof(PlayerState::step) + sizeof(PlayerState::actionStep)) << 3) +
+           NetWriteStream::QuantizedBits(-kPositionBound, kPositionBound, kPositionPrecision) * 2 +
+           kDirectionBits + kActionStateBits;
+}
+
+uint32_t
+RoomSnapshot::EnemyStateBits()
+{
+    return ((sizeof(EnemyState::id) + sizeof(EnemyState::step)) << 3) +
+           NetWriteStream::QuantizedBits(-kPositionBound, kPositionBound, kPositionPrecision) * 2 +
+           kHealthBits;
+}
+
+bool
+RoomSnapshot::Equals(const PlayerState &a, const PlayerState &b)
+{
+    return a.step == b.step &&
+           a.x == b.x && a.y == b.y &&
+           a.dx == b.dx && a.dy == b.dy &&
+           a.actionState == b.actionState &&
+           a.actionStep == b.actionStep;
+}
+
+bool
+RoomSnapshot::Equals(const EnemyState &a, const EnemyState &b)
+{
+    return a.step == b.step && a.x == b.x && a.y == b.y && a.health == b.health;
+}
+
+void
+RoomSnapshot::Copy(PlayerState &dst, const PlayerState &src)
+{
+    dst.step = src.step;
+    dst.x = src.x;
+    dst.y = src.y;
+    dst.dx = src.dx;
+    dst.dy = src.dy;
+    dst.actionState = src.actionState;
+    dst.actionStep = src.actionStep;
+}
+
+void
+RoomSnapshot::Copy(EnemyState &dst, const EnemyState &src)
+{
+    dst.step = src.step;
+    dst.x = src.x;
+    dst.y = src.y;
+    dst.health = src.health;
+}
+
+const RoomSnapshot*
+RoomSnapshot::FindBaseline(uint8_t baselineOffset) const
+{
+    if (0 == baselineOffset || nullptr == history)
+        return nullptr;
+
+    return history->Find(sequence - baselineOffset);
+}
+
+void
+RoomSnapshot::Reserve(uint8_t maxPlayers, uint8_t maxEnemies)
+{
+    while (players.Count() < maxPlayers)
+    {
+        players.PushBack(SmartPtr<PlayerState>::MakeNew<BlocksAllocator>());
+        playersChanged.PushBack(0);
+    }
+
+    while (enemies.Count() < maxEnemies)
+    {
+        enemies.PushBack(SmartPtr<EnemyState>::MakeNew<BlocksAllocator>());
+        enemiesChanged.PushBack(0);
+    }
+
+    while (relevant.Count() < players.Count() + enemies.Count())
+        relevant.PushBack(1);
+}
+
+void
+RoomSnapshot::Clear()
+{
+    playersCount = 0;
+    enemiesCount = 0;
+    baseline = nullptr;
+    interest = nullptr;
+    baselineInterest = nullptr;
+}
+
+const SmartPtr<PlayerState>&
+RoomSnapshot::AddPlayer()
+{
+    assert(playersCount < players.Count());
+    return players[playersCount++];
+}
+
+const SmartPtr<EnemyState>&
+RoomSnapshot::AddEnemy()
+{
+    assert(enemiesCount < enemies.Count());
+    return enemies[enemiesCount++];
+}
+
+RoomSnapshotHistory::RoomSnapshotHistory()
+{ }
+
+RoomSnapshotHistory::~RoomSnapshotHistory()
+{ }
+
+void
+RoomSnapshotHistory::Reserve(uint8_t maxPlayers, uint8_t maxEnemies)
+{
+    for (uint32_t i = 0; i < RoomSnapshot::kHistorySize; ++i)
+    {
+        if (!snapshots[i].IsValid())
+            snapshots[i] = SmartPtr<RoomSnapshot>::MakeNew<BlocksAllocator>();
+
+        snapshots[i]->sequence = 0;
+        snapshots[i]->Reserve(maxPlayers, maxEnemies);
+    }
+}
+
+const SmartPtr<RoomSnapshot>&
+RoomSnapshotHistory::Next(uint16_t sequence)
+{
+    auto &snapshot = snapshots[sequence % RoomSnapshot::kHistorySize];
+    assert(snapshot.IsValid());
+
+    snapshot->Clear();
+    snapshot->sequence = sequence;
+
+    return snapshot;
+}
+
+void
+RoomSnapshotHistory::Invalidate()
+{
+    for (uint32_t i = 0; i < RoomSnapshot::kHistorySize; ++i)
+    {
+        if (snapshots[i].IsValid())
+            snapshots[i]->sequence = 0;
+    }
+}
+
+void
+RoomSnapshotHistory::Store(const SmartPtr<RoomSnapshot> &snapshot)
+{
+    assert(snapshot->sequence != 0);
+
+    auto &slot = snapshots[snapshot->sequence % RoomSnapshot::kHistorySize];
+    if (!slot.IsValid() || RoomSnapshot::IsNewer(snapshot->sequence, slot->sequence))
+        slot = snapshot;
+}
+
+void
+RoomSnapshotHistory::Clear()
+{
+    for (uint32_t i = 0; i < RoomSnapshot::kHistorySize; ++i)
+        snapshots[i].Reset();
+}
+
+const RoomSnapshot*
+RoomSnapshotHistory::Find(uint16_t sequence) const
+{
+    if (0 == sequence)
+        return nullptr;
+
+    auto &snapshot = snapshots[sequence % RoomSnapshot::kHistorySize];
+    if (snapshot.IsValid() && snapshot->sequence == sequence)
+        return snapshot.Get();
+
+    return nullptr;
+}
+
+    } // namespace Messages
+} // namespace Network
@@ -0,0 +1,305 @@
+#pragma once
+
+#include "Core/SmartPtr.h"
+#include "Core/Collections/Array_type.h"
+#include "Core/Memory/BlocksAllocator.h"
+#include "Network/Serializable.h"
+#include "Network/Messages/PlayerState.h"
+#include "Network/Messages/EnemyState.h"
+
+namespace Network {
+    namespace Messages {
+
+class RoomSnapshotHistory;
+
+// The state of every player and every enemy of a room's sim step, in one packet.
+// It's encoded as a delta against a baseline, an older snapshot the receiver acknowledged:
+// an entity that didn't change since then costs one bit, a field that didn't change one bit.
+// Entities the receiver doesn't get this time, out of its interest or its bandwidth budget,
+// cost one bit too and carry no state.
+class RoomSnapshot : public Network::Serializable {
+    DeclareClassInfo;
+    DeclareSerializable;
+public:
+    enum EntityType
+    {
+        Players = 0,
+        Enemies,
+
+        EntityTypesCount
+    };
+protected:
+    // whether a field differs from the baseline, there's no bit at all without one
+    template <typename Stream> bool SerializeChanged(Stream &stream, bool changed, bool hasBaseline)
+    {
+        if (!hasBaseline)
+            return true;
+
+        stream.Serialize(changed);
+        return changed;
+    }
+
+    template <typename Stream> void SerializePositionField(Stream &stream, float &x, float &y, float baseX, float baseY, bool hasBaseline)
+    {
+        if (this->SerializeChanged(stream, Stream::IsWriting && (x != baseX || y != baseY), hasBaseline))
+        {
+            stream.SerializeQuantizedFloat(x, -kPositionBound, kPositionBound, kPositionPrecision);
+            stream.SerializeQuantizedFloat(y, -kPositionBound, kPositionBound, kPositionPrecision);
+        }
+        else
+        {
+            x = baseX;
+            y = baseY;
+        }
+    }
+
+    template <typename Stream> void SerializeDirectionField(Stream &stream, float &x, float &y, float baseX, float baseY, bool hasBaseline)
+    {
+        if (this->SerializeChanged(stream, Stream::IsWriting && (x != baseX || y != baseY), hasBaseline))
+            stream.SerializeDirection(x, y, kDirectionBits);
+        else
+        {
+            x = baseX;
+            y = baseY;
+        }
+    }
+
+    template <typename Stream, typename T> void SerializeBitsField(Stream &stream, T &value, const T &baseValue, uint32_t bitsCount, bool hasBaseline)
+    {
+        if (this->SerializeChanged(stream, Stream::IsWriting && value != baseValue, hasBaseline))
+            stream.SerializeBits(value, bitsCount);
+        else
+            value = baseValue;
+    }
+
+    // steps mostly move forward by a few sim steps, that fits a byte
+    template <typename Stream> void SerializeStepField(Stream &stream, uint32_t &step, const uint32_t &baseStep, bool hasBaseline)
+    {
+        if (!this->SerializeChanged(stream, Stream::IsWriting && step != baseStep, hasBaseline))
+        {
+            step = baseStep;
+            return;
+        }
+
+        uint8_t stepDelta = (uint8_t)(step - baseStep);
+        bool isSmall = hasBaseline && (Stream::IsWriting ? step > baseStep && step - baseStep <= 0xff : true);
+        if (hasBaseline)
+            stream.Serialize(isSmall);
+
+        if (isSmall)
+        {
+            stream.Serialize(stepDelta);
+            step = baseStep + stepDelta;
+        }
+        else
+            stream.Serialize(step);
+    }
+
+    template <typename Stream> void SerializePlayer(Stream &stream, PlayerState &state, const PlayerState *base, uint8_t &changed)
+    {
+        bool hasBaseline = base != nullptr;
+        const PlayerState &b = hasBaseline ? *base : state;
+
+        fullBits[Players] += PlayerStateBits();
+        changed = this->SerializeChanged(stream, Stream::IsWriting && !Equals(state, b), hasBaseline);
+        if (!changed)
+        {
+            Copy(state, b);
+            return;
+        }
+
+        this->SerializeStepField(stream, state.step, b.step, hasBaseline);
+        this->SerializePositionField(stream, state.x, state.y, b.x, b.y, hasBaseline);
+        this->SerializeDirectionField(stream, state.dx, state.dy, b.dx, b.dy, hasBaseline);
+        this->SerializeBitsField(stream, state.actionState, b.actionState, kActionStateBits, hasBaseline);
+        this->SerializeStepField(stream, state.actionStep, b.actionStep, hasBaseline);
+    }
+
+    template <typename Stream> void SerializeEnemy(Stream &stream, EnemyState &state, const EnemyState *base, uint8_t &changed)
+    {
+        bool hasBaseline = base != nullptr;
+        const EnemyState &b = hasBaseline ? *base : state;
+
+        fullBits[Enemies] += EnemyStateBits();
+        changed = this->SerializeChanged(stream, Stream::IsWriting && !Equals(state, b), hasBaseline);
+        if (!changed)
+        {
+            Copy(state, b);
+            return;
+        }
+
+        this->SerializeStepField(stream, state.step, b.step, hasBaseline);
+        this->SerializePositionField(stream, state.x, state.y, b.x, b.y, hasBaseline);
+        this->SerializeBitsField(stream, state.health, b.health, kHealthBits, hasBaseline);
+    }
+
+    // whether the entity goes to the receiver, without it there's nothing else
+    template <typename Stream> bool SerializeRelevant(Stream &stream, uint32_t index)
+    {
+        bool isRelevant = (Stream::IsWriting ? nullptr == interest || interest[index] != 0 : false);
+        stream.Serialize(isRelevant);
+        relevant[index] = isRelevant;
+        return isRelevant;
+    }
+
+    // the baseline can only stand for what the receiver got with it
+    template <typename Stream> bool WasRelevant(uint32_t index) const
+    {
+        if (Stream::IsWriting)
+            return nullptr == baselineInterest || baselineInterest[index] != 0;
+
+        return baseline->relevant[index] != 0;
+    }
+
+    template <typename Stream> void SerializeImpl(Stream &stream)
+    {
+        for (uint32_t i = 0; i < EntityTypesCount; ++i)
+            fullBits[i] = writtenBits[i] = 0;
+
+        stream.Serialize(sequence);
+
+        uint8_t baselineOffset = (baseline != nullptr ? (uint8_t)(sequence - baseline->sequence) : 0);
+        stream.Serialize(baselineOffset);
+        if (!Stream::IsWriting)
+        {
+            baseline = this->FindBaseline(baselineOffset);
+            complete = (0 == baselineOffset || baseline != nullptr);
+            if (!complete)
+                return;
+        }
+
+        Core::IO::BitStream::BitSize startBits = stream.GetWrittenBits();
+
+        stream.Serialize(playersCount);
+        fullBits[Players] += sizeof(playersCount) << 3;
+        if (!Stream::IsWriting)
+            this->Reserve(playersCount, 0);
+        for (uint8_t i = 0; i < playersCount; ++i)
+        {
+            players[i]->id = i;
+            if (!this->SerializeRelevant(stream, i))
+            {
+                fullBits[Players] += PlayerStateBits();
+                playersChanged[i] = 0;
+                continue;
+            }
+
+            const PlayerState *base = (baseline != nullptr && i < baseline->playersCount && this->WasRelevant<Stream>(i) ? baseline->players[i].Get() : nullptr);
+            this->SerializePlayer(stream, *players[i], base, playersChanged[i]);
+        }
+
+        writtenBits[Players] = stream.GetWrittenBits() - startBits;
+        startBits = stream.GetWrittenBits();
+
+        stream.Serialize(enemiesCount);
+        fullBits[Enemies] += sizeof(enemiesCount) << 3;
+        if (!Stream::IsWriting)
+            this->Reserve(0, enemiesCount);
+        for (uint8_t i = 0; i < enemiesCount; ++i)
+        {
+            enemies[i]->id = i;
+            if (!this->SerializeRelevant(stream, playersCount + i))
+            {
+                fullBits[Enemies] += EnemyStateBits();
+                enemiesChanged[i] = 0;
+                continue;
+            }
+
+            const EnemyState *base = (baseline != nullptr && i < baseline->enemiesCount && this->WasRelevant<Stream>(baseline->playersCount + i) ? baseline->enemies[i].Get() : nullptr);
+            this->SerializeEnemy(stream, *enemies[i], base, enemiesChanged[i]);
+        }
+
+        writtenBits[Enemies] = stream.GetWrittenBits() - startBits;
+
+        if (!Stream::IsWriting)
+            baseline = nullptr; // it may leave the history before this snapshot does
+    }
+
+    static bool Equals(const PlayerState &a, const PlayerState &b);
+    static bool Equals(const EnemyState &a, const EnemyState &b);
+    static void Copy(PlayerState &dst, const PlayerState &src);
+    static void Copy(EnemyState &dst, const EnemyState &src);
+
+    const RoomSnapshot* FindBaseline(uint8_t baselineOffset) const;
+public:
+    static const uint32_t kHistorySize = 32; // older snapshots can't be baselines, a full one gets sent
+
+    // what an entity costs without a baseline, as a standalone message minus the FCC
+    static uint32_t PlayerStateBits();
+    static uint32_t EnemyStateBits();
+
+    uint16_t sequence; // never 0, that acknowledges nothing
+    uint8_t playersCount;
+    uint8_t enemiesCount;
+    Core::Collections::Array<SmartPtr<PlayerState>> players;
+    Core::Collections::Array<SmartPtr<EnemyState>> enemies;
+    Core::Collections::Array<uint8_t> playersChanged;
+    Core::Collections::Array<uint8_t> enemiesChanged;
+    Core::Collections::Array<uint8_t> relevant;     // players then enemies, whether the receiver got them
+
+    const RoomSnapshot *baseline;           // sender: what to encode against, nullptr sends it whole
+    const uint8_t *interest;                // sender: players then enemies the receiver gets, nullptr is all
+    const uint8_t *baselineInterest;        // sender: the same for the baseline, as it went to this receiver
+    const RoomSnapshotHistory *history;     // receiver: where to look the baseline up
+    bool complete;                          // receiver: false if the baseline wasn't there, drop it
+
+    // bits of the last encoding by entity type, and what every entity costs without a baseline or interest
+    uint32_t writtenBits[EntityTypesCount];
+    uint32_t fullBits[EntityTypesCount];
+
+    RoomSnapshot();
+    RoomSnapshot(const RoomSnapshot &other) = delete;
+    virtual ~RoomSnapshot();
+
+    RoomSnapshot& operator =(const RoomSnapshot &other) = delete;
+
+    // states are allocated up front so that filling the snapshot doesn't allocate
+    void Reserve(uint8_t maxPlayers, uint8_t maxEnemies);
+    void Clear();
+
+    const SmartPtr<PlayerState>& AddPlayer();
+    const SmartPtr<EnemyState>& AddEnemy();
+
+    static uint16_t NextSequence(uint16_t sequence);
+    static bool IsNewer(uint16_t sequence, uint16_t other);
+protected:
+    virtual void OnRecycle();
+};
+
+// The last kHistorySize snapshots by sequence, the baselines that new ones are encoded against.
+class RoomSnapshotHistory {
+protected:
+    SmartPtr<RoomSnapshot> snapshots[RoomSnapshot::kHistorySize];
+public:
+    RoomSnapshotHistory();
+    RoomSnapshotHistory(const RoomSnapshotHistory &other) = default;
+    RoomSnapshotHistory(RoomSnapshotHistory &&other) = default;
+    ~RoomSnapshotHistory();
+
+    // sender: every slot gets a snapshot to fill, reused when the sequence wraps around it
+    void Reserve(uint8_t maxPlayers, uint8_t maxEnemies);
+    const SmartPtr<RoomSnapshot>& Next(uint16_t sequence);
+    // sender: entity ids changed, nothing sent so far can be a baseline anymore
+    void Invalidate();
+
+    // receiver: keeps what it decoded
+    void Store(const SmartPtr<RoomSnapshot> &snapshot);
+    void Clear();
+
+    const RoomSnapshot* Find(uint16_t sequence) const;
+};
+
+inline uint16_t
+RoomSnapshot::NextSequence(uint16_t sequence)
+{
+    return (0xffff == sequence ? 1 : sequence + 1);
+}
+
+inline bool
+RoomSnapshot::IsNewer(uint16_t sequence, uint16_t other)
+{
+    return 0 == other || (sequence != 0 && (int16_t)(sequence - other) > 0);
+}
+
+    } // namespace Messages
+} // namespace Network
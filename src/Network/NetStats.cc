@@ -0,0 +1,118 @@
+#include "Network/NetStats.h"
+
+namespace Network {
+
+NetStats::NetStats()
+{
+    for (uint32_t i = 0; i < kSlotsCount; ++i)
+    {
+        Slot &slot = slots[i];
+        slot.fcc = 0;
+        slot.sentPackets = slot.sentBytes = 0;
+        slot.receivedPackets = slot.receivedBytes = 0;
+    }
+}
+
+NetStats::~NetStats()
+{ }
+
+NetStats::Slot*
+NetStats::FindSlot(uint32_t fcc)
+{ // same mix as MessageDispatcher, linear probing, the first sender of a class claims its slot
+    uint32_t index = (fcc * 0x9e3779b1u) >> (32 - kSlotsBits);
+    for (uint32_t i = 0; i < kSlotsCount; ++i)
+    {
+        Slot &slot = slots[index];
+
+        uint32_t slotFCC = slot.fcc.load(std::memory_order_acquire);
+        if (slotFCC == fcc)
+            return &slot;
+
+        if (0 == slotFCC && slot.fcc.compare_exchange_strong(slotFCC, fcc))
+            return &slot;
+        if (slotFCC == fcc) // claimed by someone else for the same class meanwhile
+            return &slot;
+
+        index = (index + 1) & (kSlotsCount - 1);
+    }
+
+    return nullptr;
+}
+
+void
+NetStats::AddSent(uint32_t fcc, uint32_t bytes, uint32_t packets)
+{
+    Slot *slot = this->FindSlot(fcc);
+    if (nullptr == slot)
+        return;
+
+    slot->sentPackets.fetch_add(packets, std::memory_order_relaxed);
+    slot->sentBytes.fetch_add((uint64_t)bytes * packets, std::memory_order_relaxed);
+}
+
+void
+NetStats::AddReceived(uint32_t fcc, uint32_t bytes)
+{
+    Slot *slot = this->FindSlot(fcc);
+    if (nullptr == slot)
+        return;
+
+    slot->receivedPackets.fetch_add(1, std::memory_order_relaxed);
+    slot->receivedBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+uint32_t
+NetStats::TakeMessages(MessageStats *stats, uint32_t maxCount)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < kSlotsCount && count < maxCount; ++i)
+    {
+        Slot &slot = slots[i];
+
+        uint32_t fcc = slot.fcc.load(std::memory_order_acquire);
+        if (0 == fcc)
+            continue;
+
+        MessageStats &messageStats = stats[count];
+        messageStats.fcc = fcc;
+        messageStats.sentPackets = slot.sentPackets.exchange(0);
+        messageStats.sentBytes = slot.sentBytes.exchange(0);
+        messageStats.receivedPackets = slot.receivedPackets.exchange(0);
+        messageStats.receivedBytes = slot.receivedBytes.exchange(0);
+
+        if (messageStats.sentPackets > 0 || messageStats.receivedPackets > 0)
+            ++count;
+    }
+
+    return count;
+}
+
+void
+NetStats::GetPeer(const ENetPeer *peer, PeerStats &stats)
+{
+    stats.address = peer->address;
+    stats.roundTripTime = peer->roundTripTime;
+    stats.roundTripTimeVariance = peer->roundTripTimeVariance;
+    stats.packetLoss = (float)peer->packetLoss / ENET_PEER_PACKET_LOSS_SCALE;
+    stats.sentPackets = peer->totalSentPackets;
+    stats.sentBytes = peer->totalSentData;
+    stats.sentUncompressedBytes = peer->totalSentUncompressedData;
+    stats.receivedPackets = peer->totalReceivedPackets;
+    stats.receivedBytes = peer->totalReceivedData;
+    stats.receivedUncompressedBytes = peer->totalReceivedUncompressedData;
+    stats.resentCommands = peer->totalResentCommands;
+}
+
+void
+NetStats::ResetPeer(ENetPeer *peer)
+{
+    peer->totalSentPackets = 0;
+    peer->totalSentData = 0;
+    peer->totalSentUncompressedData = 0;
+    peer->totalReceivedPackets = 0;
+    peer->totalReceivedData = 0;
+    peer->totalReceivedUncompressedData = 0;
+    peer->totalResentCommands = 0;
+}
+
+}; // namespace Network
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#define NOMINMAX
+#include "enet/enet.h"
+
+namespace Network {
+
+// What a host sends and receives, by message class and by peer.
+// Message counters are summed by whoever sends, room jobs included, so they're atomics
+// in a small open addressed table by FCC. They count message bytes: ENet packs several
+// messages in one UDP packet and compresses that, so compressed sizes are only known by peer,
+// from the totals ENet keeps in the peer itself.
+class NetStats {
+public:
+    static const uint32_t kMaxMessages = 32;
+
+    struct MessageStats
+    {
+        uint32_t fcc;
+        uint64_t sentPackets;
+        uint64_t sentBytes;
+        uint64_t receivedPackets;
+        uint64_t receivedBytes;
+    };
+
+    struct PeerStats
+    {
+        ENetAddress address;
+        uint32_t roundTripTime;             // ms, mean and variance as ENet keeps them
+        uint32_t roundTripTimeVariance;
+        float packetLoss;                   // of reliable packets, 0 to 1
+        uint32_t sentPackets;               // UDP packets
+        uint32_t sentBytes;                 // compressed
+        uint32_t sentUncompressedBytes;
+        uint32_t receivedPackets;
+        uint32_t receivedBytes;
+        uint32_t receivedUncompressedBytes;
+        uint32_t resentCommands;            // reliable commands that timed out and went again
+    };
+protected:
+    static const uint32_t kSlotsBits = 6;
+    static const uint32_t kSlotsCount = 1 << kSlotsBits;
+
+    struct Slot
+    {
+        std::atomic<uint32_t> fcc; // 0 is a free slot, claimed once and never released
+        std::atomic<uint64_t> sentPackets;
+        std::atomic<uint64_t> sentBytes;
+        std::atomic<uint64_t> receivedPackets;
+        std::atomic<uint64_t> receivedBytes;
+    };
+
+    Slot slots[kSlotsCount];
+
+    // nullptr if the table is full, the message goes uncounted
+    Slot* FindSlot(uint32_t fcc);
+public:
+    NetStats();
+    NetStats(const NetStats &other) = delete;
+    ~NetStats();
+
+    NetStats& operator =(const NetStats &other) = delete;
+
+    void AddSent(uint32_t fcc, uint32_t bytes, uint32_t packets = 1);
+    void AddReceived(uint32_t fcc, uint32_t bytes);
+
+    // copies up to maxCount message counters out, those that counted anything, and zeroes them
+    uint32_t TakeMessages(MessageStats *stats, uint32_t maxCount);
+
+    // counters since the last reset, ENet's totals are 32 bits so they need one now and then
+    static void GetPeer(const ENetPeer *peer, PeerStats &stats);
+    static void ResetPeer(ENetPeer *peer);
+};
+
+}; // namespace Network
@@ -3,24 +3,48 @@
 #define NOMINMAX
 #include "enet/enet.h"
 
+#include "Core/Debug.h"
 #include "Core/IO/BitStream.h"
 #include "Math/Math.h"
 
 namespace Network {
 
+// Values of a broadcast encoding that depend on the receiver, they get rewritten
+// for every peer after the message has been serialized once without one.
+// Only timestamps could need it, and only with kPeerTimestamps.
+struct NetPatches
+{
+    static const uint32_t kMaxPatches = 4;
+
+    struct Patch
+    {
+        Core::IO::BitStream::BitSize bitPos;
+        float timestamp;
+    };
+
+    Patch patches[kMaxPatches];
+    uint32_t count;
+
+    NetPatches()
+    : count(0)
+    { }
+};
+
 template <bool IsReader>
 class NetStream {
 protected:
     ENetPeer *peer;
     Core::IO::BitStream &stream;
+    NetPatches *patches;
 public:
     enum {
         IsWriting = IsReader ? 0 : 1
     };
 
-    NetStream(ENetPeer *_peer, Core::IO::BitStream &_stream)
+    NetStream(ENetPeer *_peer, Core::IO::BitStream &_stream, NetPatches *_patches = nullptr)
     : peer(_peer),
-      stream(_stream)
+      stream(_stream),
+      patches(_patches)
     {
         if (IsReader)
             stream.Rewind();
@@ -31,6 +55,11 @@ public:
     ~NetStream()
     { }
 
+    Core::IO::BitStream::BitSize GetWrittenBits() const
+    {
+        return stream.GetSizeInBits();
+    }
+
     template <typename T> bool Serialize(T &value)
     {
         if (IsReader)
@@ -51,6 +80,26 @@ public:
         }
     }
 
+    // a single bit, not sizeof(bool) bytes, the last one may end the stream
+    bool Serialize(bool &value)
+    {
+        if (IsReader)
+        {
+            if (stream.RemainingBits() >= 1)
+            {
+                stream >> value;
+                return true;
+            }
+            else
+                return false;
+        }
+        else
+        {
+            stream << value;
+            return true;
+        }
+    }
+
     template <typename T> bool SerializeArray(Core::Collections::Array<T> &array) // ToDo: different sizes (1, 2, 4 bytes)
     {
         if (IsReader)
@@ -68,6 +117,7 @@ public:
                         return false;
                     stream >> array[i];
                 }
+                return true;
             }
             else
                 return false;
@@ -94,6 +144,7 @@ public:
                 stream >> halfFloat;
                 uint32_t valueInt = Math::HalfToFloat(halfFloat);
                 value = *(float*)&valueInt;
+                return true;
             }
             else
                 return false;
@@ -106,6 +157,99 @@ public:
         }
     }
 
+    // any integer or enum, in bitsCount bits instead of sizeof(T) bytes
+    template <typename T> bool SerializeBits(T &value, uint32_t bitsCount)
+    {
+        if (IsReader)
+        {
+            if (stream.RemainingBits() >= bitsCount)
+            {
+                value = (T)stream.ReadUInt(bitsCount);
+                return true;
+            }
+            else
+                return false;
+        }
+        else
+        {
+            assert(bitsCount == 32 || (uint32_t)value < (1u << bitsCount));
+            stream.WriteUInt((uint32_t)value, bitsCount);
+            return true;
+        }
+    }
+
+    template <typename T> bool SerializeRangedInt(T &value, int32_t min, int32_t max)
+    {
+        assert(min < max);
+        uint32_t bitsCount = BitsRequired((uint32_t)(max - min));
+
+        if (IsReader)
+        {
+            uint32_t offset;
+            if (!this->SerializeBits(offset, bitsCount) || offset > (uint32_t)(max - min))
+                return false;
+
+            value = (T)(min + (int32_t)offset);
+            return true;
+        }
+        else
+        {
+            assert((int32_t)value >= min && (int32_t)value <= max);
+            uint32_t offset = (uint32_t)((int32_t)value - min);
+            return this->SerializeBits(offset, bitsCount);
+        }
+    }
+
+    // values out of [min, max] get clamped, the reader gets them back within precision
+    bool SerializeQuantizedFloat(float &value, float min, float max, float precision)
+    {
+        uint32_t maxInt = QuantizedMax(min, max, precision),
+                 bitsCount = BitsRequired(maxInt);
+
+        if (IsReader)
+        {
+            uint32_t quantized;
+            if (!this->SerializeBits(quantized, bitsCount) || quantized > maxInt)
+                return false;
+
+            value = DequantizeFloat(quantized, min, max, maxInt);
+            return true;
+        }
+        else
+        {
+            uint32_t quantized = QuantizeFloat(value, min, max, maxInt);
+            return this->SerializeBits(quantized, bitsCount);
+        }
+    }
+
+    // a unit vector as its angle, bitsCount bits over the whole circle
+    bool SerializeDirection(float &x, float &y, uint32_t bitsCount)
+    {
+        assert(bitsCount > 0 && bitsCount < 32);
+        float steps = (float)(1u << bitsCount);
+
+        if (IsReader)
+        {
+            uint32_t quantized;
+            if (!this->SerializeBits(quantized, bitsCount))
+                return false;
+
+            float angle = quantized * (Math::TwoPi / steps);
+            x = cosf(angle);
+            y = sinf(angle);
+            return true;
+        }
+        else
+        {
+            float angle = atan2f(y, x);
+            if (angle < .0f)
+                angle += Math::TwoPi;
+
+            uint32_t quantized = (uint32_t)floorf(angle * (steps / Math::TwoPi) + 0.5f) & ((1u << bitsCount) - 1);
+            return this->SerializeBits(quantized, bitsCount);
+        }
+    }
+
     bool SerializeTimestamp(float &timestamp)
     {
         if (IsReader)
@@ -123,12 +267,66 @@ public:
         }
         else
         {
-            uint32_t t = timestamp * 1000.0f;
-            //t += enet_peer_clock_differential(peer);
+            if (kPeerTimestamps && patches != nullptr)
+            {
+                assert(patches->count < NetPatches::kMaxPatches);
+                NetPatches::Patch &patch = patches->patches[patches->count++];
+                patch.bitPos = stream.GetSizeInBits();
+                patch.timestamp = timestamp;
+            }
+
+            uint32_t t = EncodeTimestamp(peer, timestamp);
             stream << t;
             return true;
         }
     }
+
+    static uint32_t BitsRequired(uint32_t maxValue)
+    {
+        uint32_t bitsCount = 1;
+        while (bitsCount < 32 && (maxValue >> bitsCount) != 0)
+            ++bitsCount;
+        return bitsCount;
+    }
+
+    static uint32_t QuantizedMax(float min, float max, float precision)
+    {
+        assert(min < max && precision > .0f);
+        return (uint32_t)ceilf((max - min) / precision);
+    }
+
+    static uint32_t QuantizeFloat(float value, float min, float max, uint32_t maxInt)
+    {
+        return (uint32_t)floorf((Math::Clamp(value, min, max) - min) * (maxInt / (max - min)) + 0.5f);
+    }
+
+    static float DequantizeFloat(uint32_t quantized, float min, float max, uint32_t maxInt)
+    {
+        return min + quantized * ((max - min) / maxInt);
+    }
+
+    // what the receiver of SerializeQuantizedFloat gets
+    static float Quantize(float value, float min, float max, float precision)
+    {
+        uint32_t maxInt = QuantizedMax(min, max, precision);
+        return DequantizeFloat(QuantizeFloat(value, min, max, maxInt), min, max, maxInt);
+    }
+
+    static uint32_t QuantizedBits(float min, float max, float precision)
+    {
+        return BitsRequired(QuantizedMax(min, max, precision));
+    }
+
+    // off, the clock differential isn't added: a timestamp encodes the same for every peer and needs no patch
+    static const bool kPeerTimestamps = false;
+
+    static uint32_t EncodeTimestamp(ENetPeer *peer, float timestamp)
+    {
+        uint32_t t = timestamp * 1000.0f;
+        if (kPeerTimestamps)
+            t += enet_peer_clock_differential(peer);
+        return t;
+    }
 };
 
 class NetReadStream : public NetStream<true> {
@@ -147,8 +345,22 @@ public:
     : NetStream(_peer, _stream)
     { }
 
+    // encodes for any receiver, collecting what has to be patched per peer
+    NetWriteStream(Core::IO::BitStream &_stream, NetPatches &_patches)
+    : NetStream(nullptr, _stream, &_patches)
+    { }
+
     ~NetWriteStream()
     { }
+
+    static void Patch(ENetPeer *peer, Core::IO::BitStream &stream, const NetPatches &patches)
+    {
+        for (uint32_t i = 0; i < patches.count; ++i)
+        {
+            uint32_t t = EncodeTimestamp(peer, patches.patches[i].timestamp);
+            stream.PatchBytes(patches.patches[i].bitPos, &t, sizeof(t));
+        }
+    }
 };
 
 } // namespace Network
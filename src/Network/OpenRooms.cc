@@ -0,0 +1,109 @@
+#include "Network/OpenRooms.h"
+#include "Core/Collections/Array.h"
+#include "Core/Memory/MallocAllocator.h"
+
+using namespace Core::Memory;
+
+namespace Network {
+
+const uint32_t OpenRooms::kNoSlot;
+const uint32_t OpenRooms::kNoRoom;
+
+OpenRooms::OpenRooms()
+: entries(GetAllocator<MallocAllocator>()),
+  heads(GetAllocator<MallocAllocator>()),
+  freeEntry(kNoSlot),
+  count(0)
+{ }
+
+OpenRooms::~OpenRooms()
+{ }
+
+uint32_t
+OpenRooms::Add(uint32_t roomId, uint8_t playersCount, uint8_t joinedCount)
+{
+    assert(joinedCount < playersCount);
+
+    uint32_t bucket = Bucket(playersCount, joinedCount);
+    if (bucket >= heads.Count())
+    {
+        uint32_t oldCount = heads.Count();
+        heads.Resize(Bucket(playersCount, playersCount - 1) + 1);
+        for (uint32_t i = oldCount; i < heads.Count(); ++i)
+            heads[i] = kNoSlot;
+    }
+
+    uint32_t slot = freeEntry;
+    if (kNoSlot == slot)
+    {
+        slot = entries.Count();
+        entries.Resize(slot + 1);
+    }
+    else
+        freeEntry = entries[slot].next;
+
+    Entry &entry = entries[slot];
+    entry.roomId = roomId;
+    entry.bucket = bucket;
+    entry.prev = kNoSlot;
+    entry.next = heads[bucket];
+    if (entry.next != kNoSlot)
+        entries[entry.next].prev = slot;
+    heads[bucket] = slot;
+
+    ++count;
+    return slot;
+}
+
+void
+OpenRooms::Remove(uint32_t slot)
+{
+    assert(slot < entries.Count() && count > 0);
+
+    Entry &entry = entries[slot];
+    if (kNoSlot == entry.prev)
+        heads[entry.bucket] = entry.next;
+    else
+        entries[entry.prev].next = entry.next;
+    if (entry.next != kNoSlot)
+        entries[entry.next].prev = entry.prev;
+
+    entry.roomId = kNoRoom;
+    entry.next = freeEntry;
+    freeEntry = slot;
+
+    --count;
+}
+
+void
+OpenRooms::Clear()
+{
+    entries.Clear();
+    for (uint32_t i = 0; i < heads.Count(); ++i)
+        heads[i] = kNoSlot;
+    freeEntry = kNoSlot;
+    count = 0;
+}
+
+uint32_t
+OpenRooms::Find(uint8_t playersCount) const
+{
+    if (0 == playersCount)
+        return kNoRoom;
+
+    uint32_t first = Bucket(playersCount, 0);
+    if (first >= heads.Count())
+        return kNoRoom;
+
+    for (uint32_t bucket = first + playersCount - 1; ; --bucket)
+    {
+        if (heads[bucket] != kNoSlot)
+            return entries[heads[bucket]].roomId;
+        if (bucket == first)
+            break;
+    }
+
+    return kNoRoom;
+}
+
+}; // namespace Network
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include "Core/Collections/Array_type.h"
+
+namespace Network {
+
+using Core::Collections::Array;
+
+// The rooms still taking players, bucketed by their players count and by how many already joined.
+// Every bucket is a list linked through the entries, a room keeps the slot Add gave it so it leaves
+// in O(1), and Find looks at one bucket per joined count to pick the room closest to starting.
+class OpenRooms {
+public:
+    static const uint32_t kNoSlot = 0xffffffff;
+    static const uint32_t kNoRoom = 0xffffffff;
+protected:
+    struct Entry
+    {
+        uint32_t roomId;
+        uint32_t bucket;
+        uint32_t prev, next; // next links the free entries too
+    };
+
+    Array<Entry> entries;
+    Array<uint32_t> heads; // first entry of every bucket, grown up to the largest room size seen
+    uint32_t freeEntry;
+    uint32_t count;
+
+    static uint32_t Bucket(uint8_t playersCount, uint8_t joinedCount);
+public:
+    OpenRooms();
+    OpenRooms(const OpenRooms &other) = delete;
+    ~OpenRooms();
+
+    OpenRooms& operator =(const OpenRooms &other) = delete;
+
+    // the slot to remove the room with
+    uint32_t Add(uint32_t roomId, uint8_t playersCount, uint8_t joinedCount);
+    void Remove(uint32_t slot);
+    void Clear();
+
+    // the id of the open room for playersCount with the most players joined, kNoRoom if none
+    uint32_t Find(uint8_t playersCount) const;
+
+    uint32_t Count() const;
+};
+
+inline uint32_t
+OpenRooms::Bucket(uint8_t playersCount, uint8_t joinedCount)
+{ // rooms for n players come after those of every smaller size, n buckets each
+    return ((uint32_t)playersCount * (playersCount - 1) >> 1) + joinedCount;
+}
+
+inline uint32_t
+OpenRooms::Count() const
+{
+    return count;
+}
+
+}; // namespace Network
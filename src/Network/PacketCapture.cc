@@ -0,0 +1,117 @@
+#include "Network/PacketCapture.h"
+#include "Core/IO/FileServer.h"
+#include "Core/Memory/MallocAllocator.h"
+#include "Core/Log.h"
+
+using namespace Core;
+using namespace Core::IO;
+using namespace Core::Memory;
+
+namespace Network {
+
+const uint32_t PacketCapture::kMagic;
+const uint32_t PacketCapture::kVersion;
+
+static const size_t kHeaderSize = 8;
+
+PacketCapture::PacketCapture()
+: stream(GetAllocator<MallocAllocator>()),
+  recordsCount(0)
+{
+    this->Clear();
+}
+
+PacketCapture::~PacketCapture()
+{ }
+
+void
+PacketCapture::Clear()
+{
+    stream.Reset();
+    stream << kMagic << kVersion;
+    recordsCount = 0;
+}
+
+void
+PacketCapture::Add(uint32_t time, RecordType type, uint8_t shard, uint16_t peer, uint8_t channel, const void *data, uint32_t size)
+{
+    stream << time << (uint8_t)type << shard << peer;
+    if (Receive == type)
+    {
+        stream << channel << size;
+        stream.WriteBytes(data, size);
+    }
+    ++recordsCount;
+}
+
+bool
+PacketCapture::Save(const char *path) const
+{
+    return 0 == FileServer::Instance()->WriteOnly(path, stream);
+}
+
+bool
+PacketCapture::Load(const char *path)
+{
+    recordsCount = 0;
+    if (FileServer::Instance()->ReadOnly(path, stream) != 0)
+    {
+        this->Clear();
+        return false;
+    }
+
+    uint32_t magic = 0, version = 0;
+    if (stream.RemainingBytes() >= kHeaderSize)
+        stream >> magic >> version;
+    if (magic != kMagic || version != kVersion)
+    {
+        Log::Instance()->Write(Log::Error, "\"%s\" isn't a capture of version %u.", path, kVersion);
+        this->Clear();
+        return false;
+    }
+
+    Record record;
+    while (this->Next(record))
+        ++recordsCount;
+    this->Rewind();
+
+    return true;
+}
+
+void
+PacketCapture::Rewind() const
+{
+    stream.Rewind();
+    stream.SkipBytes(kHeaderSize);
+}
+
+bool
+PacketCapture::Next(Record &record) const
+{
+    if (stream.RemainingBytes() < 8)
+        return false;
+
+    uint8_t type;
+    stream >> record.time >> type >> record.shard >> record.peer;
+    record.type = (RecordType)type;
+    record.channel = 0;
+    record.size = 0;
+    record.data = nullptr;
+
+    if (Receive == record.type)
+    {
+        if (stream.RemainingBytes() < 5)
+            return false;
+
+        stream >> record.channel >> record.size;
+        if (stream.RemainingBytes() < record.size)
+            return false;
+
+        record.data = static_cast<const uint8_t*>(stream.GetReadPos());
+        stream.SkipBytes(record.size);
+    }
+
+    return record.type <= Receive;
+}
+
+}; // namespace Network
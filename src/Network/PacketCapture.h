@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include "Core/IO/BitStream.h"
+
+namespace Network {
+
+// What a server received, to feed it again to another build of the server.
+// A header (kMagic, kVersion) then one record per event, byte aligned and little endian:
+// uint32 ms since the capture started, uint8 type, uint8 shard, uint16 peer id in the shard's host,
+// and for packets uint8 channel, uint32 size and the packet as ENet delivered it, decompressed.
+// The capture is kept in memory and written whole through the FileServer.
+class PacketCapture {
+public:
+    static const uint32_t kMagic = 0x43504854; // "THPC"
+    static const uint32_t kVersion = 1;
+
+    enum RecordType
+    {
+        Connect = 0,
+        Disconnect,
+        Receive
+    };
+
+    struct Record
+    {
+        uint32_t time;
+        RecordType type;
+        uint8_t shard;
+        uint16_t peer;
+        uint8_t channel;
+        uint32_t size;
+        const uint8_t *data; // into the capture, valid while it lives
+    };
+protected:
+    Core::IO::BitStream stream;
+    uint32_t recordsCount;
+public:
+    PacketCapture();
+    ~PacketCapture();
+
+    void Clear();
+    void Add(uint32_t time, RecordType type, uint8_t shard, uint16_t peer, uint8_t channel = 0, const void *data = nullptr, uint32_t size = 0);
+
+    bool Save(const char *path) const;
+    bool Load(const char *path);
+
+    // from the first record, false at the end or on a truncated record
+    void Rewind() const;
+    bool Next(Record &record) const;
+
+    size_t GetSize() const;
+    uint32_t GetRecordsCount() const;
+};
+
+inline size_t
+PacketCapture::GetSize() const
+{
+    return stream.GetSize();
+}
+
+inline uint32_t
+PacketCapture::GetRecordsCount() const
+{
+    return recordsCount;
+}
+
+}; // namespace Network
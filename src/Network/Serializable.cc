@@ -5,6 +5,10 @@ namespace Network {
 DefineClassInfoWithFactoryAndFCC(Network::Serializable, 'SERI', Core::RefCounted);
 DefineSerializable(Network::Serializable);
 
+const float Serializable::kPositionBound = 512.0f;
+const float Serializable::kPositionPrecision = 1.0f / 512.0f;
+const float Serializable::kInputPrecision = 1.0f / 127.0f;
+
 Serializable::Serializable()
 { }
 
@@ -6,6 +6,7 @@
 #define DeclareSerializable \
 public: \
     virtual void Serialize(ENetPeer *peer, Core::IO::BitStream &stream); \
+    virtual void Serialize(Core::IO::BitStream &stream, Network::NetPatches &patches); \
     virtual void Deserialize(ENetPeer *peer, Core::IO::BitStream &stream);
 
 #define DefineSerializable(type) \
@@ -16,6 +17,13 @@ void type::Serialize(ENetPeer *peer, Core::IO::BitStream &stream) \
     this->SerializeImpl(writeStream); \
 } \
  \
+void type::Serialize(Core::IO::BitStream &stream, Network::NetPatches &patches) \
+{ \
+    Network::NetWriteStream writeStream(stream, patches); \
+    stream << type::RTTI.GetFCC(); \
+    this->SerializeImpl(writeStream); \
+} \
+ \
 void type::Deserialize(ENetPeer *peer, Core::IO::BitStream &stream) \
 { \
     Network::NetReadStream readStream(peer, stream); \
@@ -34,6 +42,14 @@ protected:
     template <typename Stream> void SerializeImpl(Stream &stream)
     { }
 public:
+    // how the gameplay messages quantize what they carry
+    static const float kPositionBound;          // positions lie within [-bound, bound] on both axes
+    static const float kPositionPrecision;
+    static const float kInputPrecision;         // input axes lie within [-1, 1]
+    static const uint32_t kDirectionBits = 10;  // unit vectors as their angle, about a third of a degree
+    static const uint32_t kActionStateBits = 2;
+    static const uint32_t kHealthBits = 2;
+
     Serializable();
     Serializable(const Serializable &other) = delete;
     virtual ~Serializable();
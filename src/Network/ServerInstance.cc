@@ -1,4 +1,9 @@
+#include <cmath>
+#include <ctime>
+#include <cstring>
+#include <algorithm>
 #include "Network/ServerInstance.h"
+#include "enet/time.h"
 #include "Core/Memory/MallocAllocator.h"
 #include "Core/Memory/LinearAllocator.h"
 #include "Core/Memory/BlocksAllocator.h"
@@ -7,8 +12,10 @@
 #include "Core/IO/BitStream.h"
 #include "Network/Messages/CreateRoom.h"
 #include "Network/Messages/JoinRoom.h"
+#include "Network/Messages/QuickJoin.h"
 #include "Network/Messages/StartGame.h"
 #include "Network/Messages/PlayerInputs.h"
+#include "Network/Messages/PlayerInputsWindow.h"
 
 using namespace Core;
 using namespace Core::IO;
@@ -17,122 +24,620 @@ using namespace Managers;
 
 namespace Network {
 
+const float ServerInstance::kStatsInterval = 10.0f;
+
+static double
+GetProcessCPUTime()
+{
+#if defined _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime);
+
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+
+    return (kernel.QuadPart + user.QuadPart) * 0.0000001;
+#else
+    return clock() / (double)CLOCKS_PER_SEC; // all threads of the process
+#endif
+}
+
+ServerInstance::Shard::Shard(uint32_t _index, ENetHost *_host)
+: index(_index),
+  host(_host),
+  rooms(GetAllocator<MallocAllocator>()),
+  events(GetAllocator<MallocAllocator>())
+{ }
+
 ServerInstance::ServerInstance()
 : HostInstance(),
-  rooms(GetAllocator<MallocAllocator>())
-{ }
+  shards(GetAllocator<MallocAllocator>()),
+  roomUpdates(GetAllocator<MallocAllocator>()),
+  phaseRooms(GetAllocator<MallocAllocator>(), kStepPhases),
+  sendStream(GetAllocator<MallocAllocator>()),
+  statsStartTime(.0),
+  statsStartCPUTime(.0),
+  statsTicks(0),
+  statsRooms(0),
+  statsSteppedRooms(0),
+  statsMaxSteppedRooms(0),
+  capturePath(GetAllocator<MallocAllocator>()),
+  capturing(false),
+  captureStartTime(0),
+  captureEndTime(0)
+{
+    for (uint32_t i = 0; i < Messages::RoomSnapshot::EntityTypesCount; ++i)
+        statsSnapshotBits[i] = statsSnapshotFullBits[i] = 0;
+
+    phaseRooms.Resize(kStepPhases);
+    for (uint32_t i = 0; i < kStepPhases; ++i)
+        phaseRooms[i] = 0;
+
+    jobSystem = SmartPtr<Jobs::JobSystem>::MakeNew<LinearAllocator>(Jobs::JobSystem::GetDefaultThreadsCount());
+
+    dispatcher.Register<Messages::CreateRoom, &ServerInstance::OnCreateRoom>();
+    dispatcher.Register<Messages::JoinRoom, &ServerInstance::OnJoinRoom>();
+    dispatcher.Register<Messages::QuickJoin, &ServerInstance::OnQuickJoin>();
+    dispatcher.Register<Messages::StartGame, &ServerInstance::OnStartGame>();
+    dispatcher.Register<Messages::PlayerInputs, &ServerInstance::OnPlayerInputs>();
+    dispatcher.Register<Messages::PlayerInputsWindow, &ServerInstance::OnPlayerInputsWindow>();
+}
 
 ServerInstance::~ServerInstance()
 { }
 
 bool
-ServerInstance::Initialize(int port)
+ServerInstance::Initialize(int port, uint32_t shardsCount)
+{
+    log->Write(Log::Info, "Updating rooms on %u workers.", jobSystem->GetWorkersCount());
+    log->Write(Log::Info, "Up to %u peers and %u channels per host, bandwidth in %u out %u bytes/s (0 unlimited), %s compressor.",
+        hostSettings.peersCount, hostSettings.channelsCount, hostSettings.incomingBandwidth, hostSettings.outgoingBandwidth,
+        GetCompressorName(hostSettings.compressor));
+
+    statsStartTime = timeServer->GetSeconds();
+    statsStartCPUTime = GetProcessCPUTime();
+
+    if (shardsCount <= 1)
+    {
+        if (!this->StartServer(port) || nullptr == host)
+            return false;
+
+        shards.PushBack(New<MallocAllocator, Shard>(0, host));
+        return true;
+    }
+
+    shardsCount = std::min(shardsCount, (uint32_t)kMaxShards);
+    if (!this->InitializeENet())
+        return false;
+
+    for (uint32_t i = 0; i < shardsCount; ++i)
+    {
+        ENetHost *shardHost = this->CreateServerHost(port, true);
+        if (nullptr == shardHost)
+        {
+            log->Write(Log::Error, "Cannot bind shard %u to port %d, SO_REUSEPORT not available?", i, port);
+            return false;
+        }
+
+        shards.PushBack(New<MallocAllocator, Shard>(i, shardHost));
+    }
+    host = shards[0]->host;
+
+    log->Write(Log::Info, "Listening on %u sharded hosts.", shards.Count());
+
+    return true;
+}
+
+uint32_t
+ServerInstance::GetRoomsCount() const
+{
+    uint32_t count = 0;
+    for (auto shardIt = shards.Begin(), shardsEnd = shards.End(); shardIt < shardsEnd; ++shardIt)
+        count += (*shardIt)->rooms.Count();
+    return count;
+}
+
+Handle<GameRoom>
+ServerInstance::GetRoom(uint32_t roomId)
 {
-    return this->StartServer(port);
+    uint32_t shardIndex = roomId & (kMaxShards - 1);
+    if (shardIndex >= shards.Count())
+        return Handle<GameRoom>();
+
+    return shards[shardIndex]->rooms.GetInstance(roomId >> kShardBits);
+}
+
+Handle<GameRoom>
+ServerInstance::GetPeerRoom(ENetPeer *peer)
+{
+    if (nullptr == peer->data)
+        return Handle<GameRoom>();
+
+    return this->GetRoom(GetPeerRoomId(peer));
+}
+
+uint32_t
+ServerInstance::NewRoom(Shard *shard, uint8_t playersCount)
+{
+    auto room = shard->rooms.NewInstance(playersCount);
+    uint32_t roomId = MakeRoomId(shard->index, room->GetInstanceID());
+
+    this->OpenRoom(roomId, room.Get());
+    return roomId;
 }
 
 void
-ServerInstance::Tick()
+ServerInstance::DestroyRoom(GameRoom *room)
 {
-    timeServer->Tick();
+    this->CloseRoom(room);
+    room->Destroy();
+}
 
-    ENetEvent event;
-    while (enet_host_service(host, &event, 0) > 0)
+void
+ServerInstance::OpenRoom(uint32_t roomId, GameRoom *room)
+{
+    assert(OpenRooms::kNoSlot == room->GetOpenSlot());
+    if (GameRoom::WaitingJoin == room->GetState() && room->GetJoinedCount() < room->GetPlayersCount())
+        room->SetOpenSlot(openRooms.Add(roomId, room->GetPlayersCount(), room->GetJoinedCount()));
+}
+
+void
+ServerInstance::CloseRoom(GameRoom *room)
+{
+    if (room->GetOpenSlot() != OpenRooms::kNoSlot)
+    {
+        openRooms.Remove(room->GetOpenSlot());
+        room->SetOpenSlot(OpenRooms::kNoSlot);
+    }
+}
+
+void
+ServerInstance::AddPlayer(ENetPeer *peer, uint32_t roomId, GameRoom *room, const SmartPtr<Messages::JoinRoom> &joinRoom)
+{
+    assert(GameRoom::WaitingJoin == room->GetState());
+    this->CloseRoom(room);
+    room->AddPlayer(peer);
+    this->OpenRoom(roomId, room);
+
+    joinRoom->roomId = roomId;
+    joinRoom->flags = Messages::JoinRoom::Success;
+    joinRoom->roomData = room->GetData();
+
+    SetPeerRoom(peer, roomId);
+}
+
+uint32_t
+ServerInstance::GetWaitTimeout() const
+{
+    uint64_t now = timeServer->GetNanoseconds(),
+             wait = kMaxWaitTime * Time::TimeServer::kNanosecondsPerMillisecond;
+
+    for (auto shardIt = shards.Begin(), shardsEnd = shards.End(); shardIt < shardsEnd; ++shardIt)
     {
-        switch (event.type)
+        auto &rooms = (*shardIt)->rooms;
+        for (auto roomIt = rooms.Begin(), roomsEnd = rooms.End(); roomIt < roomsEnd; ++roomIt)
         {
-        case ENET_EVENT_TYPE_CONNECT:
-            log->Write(Log::Info, "Connected with %x:%u.",
-                event.peer->address.host,
-                event.peer->address.port);
-            break;
-        case ENET_EVENT_TYPE_DISCONNECT:
-            log->Write(Log::Info, "Disconnected from %x:%u.",
-                event.peer->address.host,
-                event.peer->address.port);
-            if (event.peer->data != nullptr)
+            if (GameRoom::Playing == roomIt->GetState())
             {
-                GameRoom *peerRoom = static_cast<GameRoom*>(event.peer->data);
-                if (peerRoom->PlayerLeft(event.peer))
-                    peerRoom->Destroy();
+                uint64_t nextStep = roomIt->GetNextStepTime();
+                wait = (nextStep <= now ? 0 : std::min(wait, nextStep - now));
+            }
+        }
+    }
+
+    return (uint32_t)((wait + Time::TimeServer::kNanosecondsPerMillisecond - 1) / Time::TimeServer::kNanosecondsPerMillisecond);
+}
+
+uint32_t
+ServerInstance::TakeStepPhase()
+{ // ties go in bit reversed order, the first rooms land half a step apart, then a quarter...
+    static_assert(16 == kStepPhases, "phase order is for 16 phases");
+    static const uint8_t phasesOrder[kStepPhases] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+
+    uint32_t phase = phasesOrder[0];
+    for (uint32_t i = 1; i < kStepPhases; ++i)
+    {
+        if (phaseRooms[phasesOrder[i]] < phaseRooms[phase])
+            phase = phasesOrder[i];
+    }
+
+    ++phaseRooms[phase];
+    return phase;
+}
+
+void
+ServerInstance::ReleaseStepPhase(uint32_t phase)
+{
+    assert(phase < kStepPhases && phaseRooms[phase] > 0);
+    --phaseRooms[phase];
+}
+
+void
+ServerInstance::WaitForEvents()
+{
+    uint32_t timeout = this->GetWaitTimeout();
+    if (0 == timeout)
+        return;
+
+    ENetSocketSet readSet;
+    ENET_SOCKETSET_EMPTY(readSet);
 
-                event.peer->data = nullptr;
+    ENetSocket maxSocket = shards[0]->host->socket;
+    for (auto shardIt = shards.Begin(), shardsEnd = shards.End(); shardIt < shardsEnd; ++shardIt)
+    {
+        ENET_SOCKETSET_ADD(readSet, (*shardIt)->host->socket);
+        maxSocket = std::max(maxSocket, (*shardIt)->host->socket);
+    }
+
+    enet_socketset_select(maxSocket, &readSet, nullptr, timeout);
+}
+
+void
+ServerInstance::UpdateStats()
+{
+    ++statsTicks;
+    statsRooms += this->GetRoomsCount();
+
+    double now = timeServer->GetSeconds();
+    float elapsed = (float)(now - statsStartTime);
+    if (elapsed < kStatsInterval)
+        return;
+
+    double cpuTime = GetProcessCPUTime();
+    float cpuUsage = (float)((cpuTime - statsStartCPUTime) / elapsed),
+          avgRooms = (float)statsRooms / statsTicks;
+
+    if (avgRooms > .0f)
+    {
+        log->Write(Log::Info, "CPU %.2f%% (%u ticks/s), %.1f rooms, %.3f%% per room.", cpuUsage * 100.0f, (uint32_t)(statsTicks / elapsed), avgRooms, cpuUsage * 100.0f / avgRooms);
+        log->Write(Log::Info, "%.2f rooms stepped per tick, %u at most.", (float)statsSteppedRooms / statsTicks, statsMaxSteppedRooms);
+    }
+    else
+        log->Write(Log::Info, "CPU %.2f%% (%u ticks/s), idle.", cpuUsage * 100.0f, (uint32_t)(statsTicks / elapsed));
+
+    uint32_t playingRooms = 0;
+    size_t arenasSize = 0;
+    for (auto shardIt = shards.Begin(), shardsEnd = shards.End(); shardIt < shardsEnd; ++shardIt)
+    {
+        auto &rooms = (*shardIt)->rooms;
+        for (auto roomIt = rooms.Begin(), roomsEnd = rooms.End(); roomIt < roomsEnd; ++roomIt)
+        {
+            if (GameRoom::Playing == roomIt->GetState())
+            {
+                ++playingRooms;
+                arenasSize += roomIt->GetArenaSize();
             }
-            break;
-        case ENET_EVENT_TYPE_RECEIVE:
-            BitStream data(GetAllocator<MallocAllocator>(), event.packet->data, event.packet->dataLength, false);
+        }
+    }
+    if (playingRooms > 0)
+        log->Write(Log::Info, "%u playing rooms, %.2f KB of level and entities each.", playingRooms, arenasSize / (1024.0f * playingRooms));
+
+    static const char *entityTypeNames[Messages::RoomSnapshot::EntityTypesCount] = { "PlayerState", "EnemyState" };
+    for (uint32_t i = 0; i < Messages::RoomSnapshot::EntityTypesCount; ++i)
+    {
+        uint64_t bits = statsSnapshotBits[i].exchange(0),
+                 fullBits = statsSnapshotFullBits[i].exchange(0);
+        if (0 == fullBits)
+            continue;
+
+        log->Write(Log::Info, "%s: %.2f KB/s as snapshot deltas, %.2f KB/s whole, %.1f%% saved.", entityTypeNames[i],
+            bits / (8192.0f * elapsed), fullBits / (8192.0f * elapsed), 100.0f - (float)(bits * 100.0 / fullBits));
+    }
+
+    this->LogNetStats(elapsed);
+
+    statsStartTime = now;
+    statsStartCPUTime = cpuTime;
+    statsTicks = 0;
+    statsRooms = 0;
+    statsSteppedRooms = 0;
+    statsMaxSteppedRooms = 0;
+}
+
+void
+ServerInstance::GetPeersStats(Array<NetStats::PeerStats> &peersStats) const
+{
+    for (auto shardIt = shards.Begin(), shardsEnd = shards.End(); shardIt < shardsEnd; ++shardIt)
+    {
+        ENetHost *shardHost = (*shardIt)->host;
+        // no peer past activePeerCount is in use, ENet itself only services those
+        for (size_t i = 0; i < shardHost->activePeerCount; ++i)
+        {
+            const ENetPeer *peer = &shardHost->peers[i];
+            if (peer->state != ENET_PEER_STATE_CONNECTED)
+                continue;
+
+            NetStats::PeerStats peerStats;
+            NetStats::GetPeer(peer, peerStats);
+            peersStats.PushBack(peerStats);
+        }
+    }
+}
+
+void
+ServerInstance::LogNetStats(float elapsed)
+{
+    NetStats::MessageStats messages[NetStats::kMaxMessages];
+    uint32_t messagesCount = netStats.TakeMessages(messages, NetStats::kMaxMessages);
+    for (uint32_t i = 0; i < messagesCount; ++i)
+    {
+        const NetStats::MessageStats &stats = messages[i];
+        const ClassInfo *classInfo = ClassInfoUtils::Instance()->FindClassFCC(stats.fcc);
+
+        log->Write(Log::Info, "%s: sent %.1f/s %.2f KB/s, received %.1f/s %.2f KB/s.", (classInfo != nullptr ? classInfo->GetName() : "?"),
+            stats.sentPackets / elapsed, stats.sentBytes / (1024.0f * elapsed),
+            stats.receivedPackets / elapsed, stats.receivedBytes / (1024.0f * elapsed));
+    }
+
+    Array<NetStats::PeerStats> peersStats(GetAllocator<ScratchAllocator>());
+    this->GetPeersStats(peersStats);
+    if (0 == peersStats.Count())
+        return;
+
+    NetStats::PeerStats total;
+    memset(&total, 0, sizeof(NetStats::PeerStats));
+    uint32_t maxRoundTripTime = 0;
+    for (auto it = peersStats.Begin(), end = peersStats.End(); it < end; ++it)
+    {
+        total.roundTripTime += it->roundTripTime;
+        total.roundTripTimeVariance += it->roundTripTimeVariance;
+        total.packetLoss += it->packetLoss;
+        total.sentPackets += it->sentPackets;
+        total.sentBytes += it->sentBytes;
+        total.sentUncompressedBytes += it->sentUncompressedBytes;
+        total.receivedPackets += it->receivedPackets;
+        total.receivedBytes += it->receivedBytes;
+        total.receivedUncompressedBytes += it->receivedUncompressedBytes;
+        total.resentCommands += it->resentCommands;
+        maxRoundTripTime = std::max(maxRoundTripTime, it->roundTripTime);
+    }
+
+    uint32_t peersCount = peersStats.Count();
+    log->Write(Log::Info, "%u peers: RTT %u ms (max %u, variance %u), loss %.2f%%, %u resends/s.", peersCount,
+        total.roundTripTime / peersCount, maxRoundTripTime, total.roundTripTimeVariance / peersCount,
+        total.packetLoss * 100.0f / peersCount, (uint32_t)(total.resentCommands / elapsed));
+    log->Write(Log::Info, "%u peers: out %.1f packets/s %.2f KB/s (%.2f KB/s uncompressed), in %.1f packets/s %.2f KB/s (%.2f KB/s uncompressed).", peersCount,
+        total.sentPackets / elapsed, total.sentBytes / (1024.0f * elapsed), total.sentUncompressedBytes / (1024.0f * elapsed),
+        total.receivedPackets / elapsed, total.receivedBytes / (1024.0f * elapsed), total.receivedUncompressedBytes / (1024.0f * elapsed));
+
+    // the slowest peers one by one, the rest is in the averages
+    std::sort(peersStats.Begin(), peersStats.End(), [](const NetStats::PeerStats &a, const NetStats::PeerStats &b)
+    {
+        return a.roundTripTime > b.roundTripTime;
+    });
+
+    uint32_t loggedCount = std::min(peersCount, (uint32_t)kStatsMaxPeers);
+    for (uint32_t i = 0; i < loggedCount; ++i)
+    {
+        const NetStats::PeerStats &stats = peersStats[i];
+        log->Write(Log::Info, "Peer %x:%u: RTT %u ms (variance %u), loss %.2f%%, %u resends, out %.2f KB/s (%.2f KB/s uncompressed), in %.2f KB/s.",
+            stats.address.host, stats.address.port, stats.roundTripTime, stats.roundTripTimeVariance, stats.packetLoss * 100.0f, stats.resentCommands,
+            stats.sentBytes / (1024.0f * elapsed), stats.sentUncompressedBytes / (1024.0f * elapsed), stats.receivedBytes / (1024.0f * elapsed));
+    }
+
+    for (auto shardIt = shards.Begin(), shardsEnd = shards.End(); shardIt < shardsEnd; ++shardIt)
+    {
+        ENetHost *shardHost = (*shardIt)->host;
+        for (size_t i = 0; i < shardHost->activePeerCount; ++i)
+            NetStats::ResetPeer(&shardHost->peers[i]);
+    }
+}
+
+void
+ServerInstance::ServiceShardJob(void *data)
+{
+    Shard *shard = static_cast<Shard*>(data);
+
+    // receive, acknowledge and decompress in parallel, events are handled later on the main thread;
+    // every enet_host_service scans all the peers, so drain what it already dispatched with enet_host_check_events
+    ENetEvent event;
+    while (enet_host_service(shard->host, &event, 0) > 0)
+    {
+        do
+            shard->events.PushBack(event);
+        while (enet_host_check_events(shard->host, &event) > 0);
+    }
+}
+
+void
+ServerInstance::FlushShardJob(void *data)
+{
+    enet_host_flush(static_cast<Shard*>(data)->host);
+}
+
+void
+ServerInstance::UpdateRoomJob(void *data)
+{
+    RoomUpdate *roomUpdate = static_cast<RoomUpdate*>(data);
+    roomUpdate->expired = roomUpdate->room->Update();
+}
+
+void
+ServerInstance::HandleEvent(Shard *shard, const ENetEvent &event)
+{
+    if (capturing)
+        this->CaptureEvent(shard, event);
+
+    switch (event.type)
+    {
+    case ENET_EVENT_TYPE_CONNECT:
+        log->Write(Log::Info, "Connected with %x:%u.",
+            event.peer->address.host,
+            event.peer->address.port);
+        break;
+    case ENET_EVENT_TYPE_DISCONNECT:
+        log->Write(Log::Info, "Disconnected from %x:%u.",
+            event.peer->address.host,
+            event.peer->address.port);
+        {
+            auto peerRoom = this->GetPeerRoom(event.peer);
+            if (peerRoom.IsValid())
+            {
+                GameRoom *room = peerRoom.Get();
+                this->CloseRoom(room);
+                if (room->PlayerLeft(event.peer))
+                    room->Destroy();
+                else
+                    this->OpenRoom(GetPeerRoomId(event.peer), room);
+            }
+
+            ClearPeerRoom(event.peer);
+        }
+        break;
+    case ENET_EVENT_TYPE_RECEIVE:
+        BitStream data(GetAllocator<MallocAllocator>(), event.packet->data, event.packet->dataLength, false);
+        if (data.RemainingBits() >= 32)
+        {
             uint32_t fcc;
             data >> fcc;
-            auto classInfo = ClassInfoUtils::Instance()->FindClassFCC(fcc);
-            if (classInfo != nullptr)
+            data.Rewind();
+
+            netStats.AddReceived(fcc, (uint32_t)event.packet->dataLength);
+        }
+        dispatcher.Dispatch(this, Sender(shard, event.peer), event.peer, data);
+
+        enet_packet_destroy(event.packet);
+        break;
+    }
+}
+
+void
+ServerInstance::OnCreateRoom(const Sender &sender, const SmartPtr<Messages::CreateRoom> &createRoom)
+{ // the room lives on the shard its creator is connected to
+    assert(Messages::CreateRoom::kUnknownId == createRoom->roomId);
+    createRoom->roomId = this->NewRoom(sender.shard, createRoom->playersCount);
+
+    this->Send(sender.peer, SmartPtr<Serializable>::CastFrom(createRoom), ReliableSequenced, 1);
+}
+
+void
+ServerInstance::OnJoinRoom(const Sender &sender, const SmartPtr<Messages::JoinRoom> &joinRoom)
+{ // the joining peer can be on any shard, the room id tells which one owns the room
+    assert(Messages::JoinRoom::Request == joinRoom->flags);
+    joinRoom->flags = Messages::JoinRoom::Fail;
+
+    auto room = this->GetRoom(joinRoom->roomId);
+    if (room.IsValid() && GameRoom::WaitingJoin == room->GetState())
+        this->AddPlayer(sender.peer, joinRoom->roomId, room.Get(), joinRoom);
+
+    this->Send(sender.peer, SmartPtr<Serializable>::CastFrom(joinRoom), ReliableSequenced, 1);
+}
+
+void
+ServerInstance::OnQuickJoin(const Sender &sender, const SmartPtr<Messages::QuickJoin> &quickJoin)
+{ // the fullest open room of that size on any shard, a new one on the sender's shard if there's none
+    assert(Messages::JoinRoom::Request == quickJoin->flags);
+    quickJoin->flags = Messages::JoinRoom::Fail;
+    quickJoin->roomId = Messages::CreateRoom::kUnknownId;
+
+    if (quickJoin->playersCount > 0 && nullptr == sender.peer->data)
+    {
+        uint32_t roomId = openRooms.Find(quickJoin->playersCount);
+        if (OpenRooms::kNoRoom == roomId)
+            roomId = this->NewRoom(sender.shard, quickJoin->playersCount);
+
+        this->AddPlayer(sender.peer, roomId, this->GetRoom(roomId).Get(), SmartPtr<Messages::JoinRoom>::CastFrom(quickJoin));
+    }
+
+    this->Send(sender.peer, SmartPtr<Serializable>::CastFrom(quickJoin), ReliableSequenced, 1);
+}
+
+void
+ServerInstance::OnStartGame(const Sender &sender, const SmartPtr<Messages::StartGame> &startGame)
+{
+    assert(Messages::StartGame::kUnknownId == startGame->playerId && Messages::StartGame::Ready == startGame->flags);
+    startGame->flags = Messages::StartGame::Fail;
+
+    auto room = this->GetRoom(startGame->roomId);
+    if (!room.IsValid() ||
+        GameRoom::Playing == room->GetState() ||
+        !room->PlayerReady(sender.peer, startGame))
+        this->Send(sender.peer, SmartPtr<Serializable>::CastFrom(startGame), ReliableSequenced, 1);
+}
+
+void
+ServerInstance::OnPlayerInputs(const Sender &sender, const SmartPtr<Messages::PlayerInputs> &playerInputs)
+{
+    auto peerRoom = this->GetPeerRoom(sender.peer);
+    if (peerRoom.IsValid())
+        peerRoom->RecvPlayerInputs(sender.peer, playerInputs);
+}
+
+void
+ServerInstance::OnPlayerInputsWindow(const Sender &sender, const SmartPtr<Messages::PlayerInputsWindow> &inputsWindow)
+{
+    auto peerRoom = this->GetPeerRoom(sender.peer);
+    if (peerRoom.IsValid())
+        peerRoom->RecvPlayerInputs(sender.peer, inputsWindow);
+}
+
+void
+ServerInstance::Tick(bool block)
+{
+    // block until a packet arrives or the next room has to step
+    if (block)
+        this->WaitForEvents();
+
+    timeServer->Tick();
+
+    // service every shard's host, one job each
+    Jobs::JobCounter shardsCounter(0);
+    for (auto shardIt = shards.Begin(), shardsEnd = shards.End(); shardIt < shardsEnd; ++shardIt)
+        jobSystem->Run(&ServerInstance::ServiceShardJob, *shardIt, &shardsCounter);
+    jobSystem->Wait(&shardsCounter);
+
+    for (auto shardIt = shards.Begin(), shardsEnd = shards.End(); shardIt < shardsEnd; ++shardIt)
+    {
+        Shard *shard = *shardIt;
+        for (auto eventIt = shard->events.Begin(), eventsEnd = shard->events.End(); eventIt < eventsEnd; ++eventIt)
+            this->HandleEvent(shard, *eventIt);
+        shard->events.Clear();
+    }
+
+    // update rooms, one job each, then send what they produced; playing rooms only once their step is due
+    roomUpdates.Clear();
+    uint64_t now = timeServer->GetNanoseconds();
+    uint32_t steppedRooms = 0;
+    for (auto shardIt = shards.Begin(), shardsEnd = shards.End(); shardIt < shardsEnd; ++shardIt)
+    {
+        auto &rooms = (*shardIt)->rooms;
+        for (auto roomIt = rooms.Begin(), roomsEnd = rooms.End(); roomIt < roomsEnd; ++roomIt)
+        {
+            if (GameRoom::Playing == roomIt->GetState())
             {
-                auto ptr = SmartPtr<Network::Serializable>::CastFrom(classInfo->Create(&GetAllocator<BlocksAllocator>()));
-                ptr->Deserialize(event.peer, data);
-
-                if (ptr->IsInstanceOf<Messages::CreateRoom>())
-                {
-                    auto createRoom = SmartPtr<Messages::CreateRoom>::CastFrom(ptr);
-                    assert(Messages::CreateRoom::kUnknownId == createRoom->roomId);
-                    createRoom->roomId = rooms.NewInstance(createRoom->playersCount)->GetInstanceID();
-
-                    this->Send(event.peer, ptr, ReliableSequenced, 1);
-                }
-                else if (ptr->IsInstanceOf<Messages::JoinRoom>())
-                {
-                    auto joinRoom = SmartPtr<Messages::JoinRoom>::CastFrom(ptr);
-                    assert(Messages::JoinRoom::Request == joinRoom->flags);
-                    joinRoom->flags = Messages::JoinRoom::Fail;
-
-                    auto room = rooms.GetInstance(joinRoom->roomId);
-                    if (room.IsValid() && GameRoom::WaitingJoin == room->GetState())
-                    {
-                        room->AddPlayer(event.peer);
-
-                        joinRoom->flags = Messages::JoinRoom::Success;
-                        joinRoom->roomData = room->GetData();
-
-                        event.peer->data = room.Get();
-                    }
-
-                    this->Send(event.peer, ptr, ReliableSequenced, 1);
-                }
-                else if (ptr->IsInstanceOf<Messages::StartGame>())
-                {
-                    auto startGame = SmartPtr<Messages::StartGame>::CastFrom(ptr);
-                    assert(Messages::StartGame::kUnknownId == startGame->playerId && Messages::StartGame::Ready == startGame->flags);
-                    startGame->flags = Messages::StartGame::Fail;
-
-                    auto room = rooms.GetInstance(startGame->roomId);
-                    if (!room.IsValid() ||
-                        GameRoom::Playing == room->GetState() ||
-                        !room->PlayerReady(event.peer, startGame))
-                        this->Send(event.peer, ptr, ReliableSequenced, 1);
-                }
-                else if (ptr->IsInstanceOf<Messages::PlayerInputs>())
-                {
-                    if (event.peer->data != nullptr)
-                    {
-                        GameRoom *peerRoom = static_cast<GameRoom*>(event.peer->data);
-                        peerRoom->RecvPlayerInputs(event.peer, SmartPtr<Messages::PlayerInputs>::CastFrom(ptr));
-                    }
-                }
+                if (roomIt->GetNextStepTime() > now)
+                    continue;
+                ++steppedRooms;
             }
-            enet_packet_destroy(event.packet);
-            break;
+            roomUpdates.PushBack(RoomUpdate(roomIt));
         }
     }
+    statsSteppedRooms += steppedRooms;
+    statsMaxSteppedRooms = std::max(statsMaxSteppedRooms, steppedRooms);
 
-    // update rooms
+    Jobs::JobCounter roomsCounter(0);
+    for (auto updIt = roomUpdates.Begin(), updEnd = roomUpdates.End(); updIt < updEnd; ++updIt)
+        jobSystem->Run(&ServerInstance::UpdateRoomJob, updIt, &roomsCounter);
+    jobSystem->Wait(&roomsCounter);
+
+    // peers of a room may be connected to different shards, see Shard, so the rooms send one after
+    // the other here and the hosts flush in parallel after
     Array<Handle<GameRoom>> roomsToDelete(GetAllocator<ScratchAllocator>());
-    for (auto roomIt = rooms.Begin(), roomsEnd = rooms.End(); roomIt < roomsEnd; ++roomIt)
+    for (auto updIt = roomUpdates.Begin(), updEnd = roomUpdates.End(); updIt < updEnd; ++updIt)
     {
-        if (roomIt->Update())
-            roomsToDelete.PushBack(roomIt);
+        updIt->room->FlushOutgoing();
+        if (updIt->expired)
+            roomsToDelete.PushBack(updIt->room);
     }
     for (auto delIt = roomsToDelete.Begin(), delEnd = roomsToDelete.End(); delIt < delEnd; ++delIt)
-        rooms.DeleteInstance(*delIt);
+        this->DestroyRoom(delIt->Get());
 
-    enet_host_flush(host);
+    for (auto shardIt = shards.Begin(), shardsEnd = shards.End(); shardIt < shardsEnd; ++shardIt)
+        jobSystem->Run(&ServerInstance::FlushShardJob, *shardIt, &shardsCounter);
+    jobSystem->Wait(&shardsCounter);
 
     auto it = managers.Begin(), end = managers.End();
     for (; it != end; ++it)
@@ -144,12 +649,33 @@ ServerInstance::Tick()
         (*it)->OnLateUpdate();
 
     RefCounted::GC.Collect();
+
+    this->UpdateStats();
+
+    if (capturing && ((captureEndTime != 0 && timeServer->GetMilliseconds() >= captureEndTime) || capture.GetSize() >= kMaxCaptureSize))
+        this->StopCapture();
 }
 
 void
 ServerInstance::RequestStop()
 {
-    rooms.Clear();
+    if (capturing)
+        this->StopCapture();
+
+    openRooms.Clear();
+    for (auto shardIt = shards.Begin(), shardsEnd = shards.End(); shardIt < shardsEnd; ++shardIt)
+    {
+        (*shardIt)->rooms.Clear();
+
+        // the first host is HostInstance's own, Stop destroys it
+        if ((*shardIt)->host != host)
+            enet_host_destroy((*shardIt)->host);
+
+        Delete<MallocAllocator>(*shardIt);
+    }
+    shards.Clear();
+
+    jobSystem.Reset();
 
     auto it = managers.Begin(), end = managers.End();
     for (; it != end; ++it)
@@ -159,32 +685,148 @@ ServerInstance::RequestStop()
 }
 
 void
-ServerInstance::Send(ENetPeer *peer, const SmartPtr<Serializable> &object, MessageType messageType, uint8_t channel)
+ServerInstance::StartCapture(const char *path, float seconds)
 {
-    BitStream data(GetAllocator<ScratchAllocator>());
+    capture.Clear();
+    capturePath = path;
+    capturing = true;
+    captureStartTime = timeServer->GetMilliseconds();
+    captureEndTime = (seconds > .0f ? captureStartTime + std::max(1u, (uint32_t)(seconds * 1000.0f)) : 0);
 
-    object->Serialize(peer, data);
-    ENetPacket *packet = enet_packet_create(data.GetData(), data.GetSize(), this->MessageTypeToFlags(messageType));
+    log->Write(Log::Info, "Capturing to \"%s\".", capturePath.AsCString());
+}
 
-    enet_peer_send(peer, channel, packet);
+bool
+ServerInstance::StopCapture()
+{
+    if (!capturing)
+        return false;
+
+    capturing = false;
+
+    bool saved = capture.Save(capturePath.AsCString());
+    if (saved)
+        log->Write(Log::Info, "Captured %u events, %.2f KB, to \"%s\".", capture.GetRecordsCount(), capture.GetSize() / 1024.0f, capturePath.AsCString());
+
+    capture.Clear();
+    return saved;
 }
 
 void
-ServerInstance::Broadcast(const Array<ENetPeer*> &peers, const SmartPtr<Serializable> &object, MessageType messageType, uint8_t channel)
+ServerInstance::CaptureEvent(Shard *shard, const ENetEvent &event)
 {
-    if (peers.Count() > 0)
+    uint32_t time = timeServer->GetMilliseconds() - captureStartTime;
+    uint16_t peerId = event.peer->incomingPeerID;
+    switch (event.type)
     {
-        BitStream data(GetAllocator<ScratchAllocator>());
+    case ENET_EVENT_TYPE_CONNECT:
+        capture.Add(time, PacketCapture::Connect, (uint8_t)shard->index, peerId);
+        break;
+    case ENET_EVENT_TYPE_DISCONNECT:
+        capture.Add(time, PacketCapture::Disconnect, (uint8_t)shard->index, peerId);
+        break;
+    case ENET_EVENT_TYPE_RECEIVE:
+        capture.Add(time, PacketCapture::Receive, (uint8_t)shard->index, peerId, event.channelID, event.packet->data, (uint32_t)event.packet->dataLength);
+        break;
+    default:
+        break;
+    }
+}
 
-        auto it = peers.Begin(), end = peers.End();
-        for (; it < end; ++it)
-        {
-            object->Serialize(*it, data);
-            ENetPacket *packet = enet_packet_create(data.GetData(), data.GetSize(), this->MessageTypeToFlags(messageType));
+// The stand-in for a captured peer: connected without a handshake, to the discard port of the
+// loopback where nobody answers, and never timing out for the acknowledgements that won't come.
+static void
+ConnectReplayPeer(ENetHost *host, ENetPeer *peer)
+{
+    enet_peer_reset(peer);
 
-            enet_peer_send(*it, channel, packet);
-        }
+    peer->channels = (ENetChannel*)enet_malloc(host->channelLimit * sizeof(ENetChannel));
+    peer->channelCount = host->channelLimit;
+    for (ENetChannel *channel = peer->channels; channel < &peer->channels[peer->channelCount]; ++channel)
+    {
+        channel->outgoingReliableSequenceNumber = 0;
+        channel->outgoingUnreliableSequenceNumber = 0;
+        channel->incomingReliableSequenceNumber = 0;
+        channel->incomingUnreliableSequenceNumber = 0;
+
+        enet_list_clear(&channel->incomingReliableCommands);
+        enet_list_clear(&channel->incomingUnreliableCommands);
+
+        channel->usedReliableWindows = 0;
+        memset(channel->reliableWindows, 0, sizeof(channel->reliableWindows));
+    }
+
+    peer->address.host = ENET_HOST_TO_NET_32(0x7f000001);
+    peer->address.port = 9;
+    peer->outgoingPeerID = peer->incomingPeerID;
+    peer->connectID = ++host->randomSeed;
+    peer->mtu = host->mtu;
+
+    enet_peer_on_connect(peer);
+    peer->state = ENET_PEER_STATE_CONNECTED;
+    enet_peer_timeout(peer, ENET_PEER_TIMEOUT_LIMIT, ENET_TIME_OVERFLOW, ENET_TIME_OVERFLOW);
+
+    size_t peerIndex = peer - host->peers;
+    if (peerIndex >= host->activePeerCount)
+        host->activePeerCount = peerIndex + 1;
+}
+
+void
+ServerInstance::ReplayRecord(const PacketCapture::Record &record)
+{
+    Shard *shard = shards[record.shard % shards.Count()];
+    ENetPeer *peer = &shard->host->peers[record.peer % shard->host->peerCount];
+
+    ENetEvent event;
+    event.peer = peer;
+    event.channelID = 0;
+    event.data = 0;
+    event.packet = nullptr;
+    switch (record.type)
+    {
+    case PacketCapture::Connect:
+        ConnectReplayPeer(shard->host, peer);
+        ClearPeerRoom(peer);
+        event.type = ENET_EVENT_TYPE_CONNECT;
+        break;
+    case PacketCapture::Disconnect:
+        if (peer->state != ENET_PEER_STATE_CONNECTED)
+            return;
+        enet_peer_reset(peer); // as ENet does before it reports a disconnection
+        event.type = ENET_EVENT_TYPE_DISCONNECT;
+        break;
+    case PacketCapture::Receive:
+        if (peer->state != ENET_PEER_STATE_CONNECTED)
+            return;
+        event.type = ENET_EVENT_TYPE_RECEIVE;
+        event.channelID = record.channel;
+        event.packet = enet_packet_create(record.data, record.size, 0);
+        break;
+    default:
+        return;
+    }
+
+    shard->events.PushBack(event);
+}
+
+void
+ServerInstance::AddSnapshotStats(const Messages::RoomSnapshot &snapshot, uint32_t peersCount)
+{
+    for (uint32_t i = 0; i < Messages::RoomSnapshot::EntityTypesCount; ++i)
+    {
+        statsSnapshotBits[i] += (uint64_t)snapshot.writtenBits[i] * peersCount;
+        statsSnapshotFullBits[i] += (uint64_t)snapshot.fullBits[i] * peersCount;
     }
 }
 
+void
+ServerInstance::Send(ENetPeer *peer, const SmartPtr<Serializable> &object, MessageType messageType, uint8_t channel)
+{
+    object->Serialize(peer, sendStream);
+    ENetPacket *packet = enet_packet_create(sendStream.GetData(), sendStream.GetSize(), this->MessageTypeToFlags(messageType));
+    netStats.AddSent(object->GetRTTI()->GetFCC(), (uint32_t)sendStream.GetSize());
+
+    enet_peer_send(peer, channel, packet);
+}
+
 }; // namespace Network
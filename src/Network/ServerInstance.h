@@ -1,30 +1,226 @@
 #pragma once
 
+#include <atomic>
 #include "Network/HostInstance.h"
 #include "Network/Serializable.h"
 #include "Network/GameRoom.h"
+#include "Network/Messages/RoomSnapshot.h"
+#include "Network/Messages/CreateRoom.h"
+#include "Network/Messages/JoinRoom.h"
+#include "Network/Messages/QuickJoin.h"
+#include "Network/Messages/StartGame.h"
+#include "Network/Messages/PlayerInputs.h"
+#include "Network/Messages/PlayerInputsWindow.h"
+#include "Network/MessageDispatcher.h"
+#include "Network/NetStats.h"
+#include "Network/PacketCapture.h"
+#include "Network/OpenRooms.h"
+#include "Core/String.h"
 #include "Core/Pool/Pool_type.h"
+#include "Core/Pool/Handle_type.h"
+#include "Core/Jobs/JobSystem.h"
 
 namespace Network {
 
 class ServerInstance : public HostInstance {
 protected:
-    Core::Pool::Pool<GameRoom> rooms;
+    // One ENet host bound to the shared port plus the rooms created through it,
+    // the kernel spreads clients over the hosts by their address.
+    // A shard doesn't own its rooms' peers nor a thread: the kernel picks a client's host and an ENet
+    // peer can't move to another one, so a room takes players from every shard. Only servicing and
+    // flushing the hosts run per shard in parallel, with the room updates; the events, which join
+    // peers to rooms, and the rooms' sends, which reach other shards' hosts, stay on the main thread.
+    struct Shard
+    {
+        uint32_t index;
+        ENetHost *host;
+        Core::Pool::Pool<GameRoom> rooms;
+        Array<ENetEvent> events;
+
+        Shard(uint32_t _index, ENetHost *_host);
+    };
+
+    struct RoomUpdate
+    {
+        GameRoom *room;
+        bool expired;
+
+        RoomUpdate()
+        { }
+
+        RoomUpdate(GameRoom *_room)
+        : room(_room), expired(false)
+        { }
+    };
+
+    // where a received message comes from
+    struct Sender
+    {
+        Shard *shard;
+        ENetPeer *peer;
+
+        Sender(Shard *_shard, ENetPeer *_peer)
+        : shard(_shard), peer(_peer)
+        { }
+    };
+
+    Array<Shard*> shards;
+    Array<RoomUpdate> roomUpdates;
+
+    // the rooms of every shard still in WaitingJoin, for QuickJoin
+    OpenRooms openRooms;
+
+    Array<uint32_t> phaseRooms; // playing rooms by step phase
+
+    SmartPtr<Core::Jobs::JobSystem> jobSystem;
+
+    MessageDispatcher<ServerInstance, Sender> dispatcher;
+    Core::IO::BitStream sendStream;
+
+    double statsStartTime;
+    double statsStartCPUTime;
+    uint32_t statsTicks;
+    uint32_t statsRooms;
+    uint32_t statsSteppedRooms;     // rooms whose step was due, summed over the ticks
+    uint32_t statsMaxSteppedRooms;  // in a single tick
+
+    // summed by the room jobs, by entity type
+    std::atomic<uint64_t> statsSnapshotBits[Messages::RoomSnapshot::EntityTypesCount];
+    std::atomic<uint64_t> statsSnapshotFullBits[Messages::RoomSnapshot::EntityTypesCount];
+
+    NetStats netStats;
+
+    // every event HandleEvent gets while capturing, saved to capturePath when the capture ends
+    PacketCapture capture;
+    Core::String capturePath;
+    bool capturing;
+    uint32_t captureStartTime; // ms
+    uint32_t captureEndTime;   // ms, 0 = no time limit
+
+    void CaptureEvent(Shard *shard, const ENetEvent &event);
+
+    void WaitForEvents();
+    void HandleEvent(Shard *shard, const ENetEvent &event);
+    void UpdateStats();
+    void LogNetStats(float elapsed);
+
+    void OnCreateRoom(const Sender &sender, const SmartPtr<Messages::CreateRoom> &createRoom);
+    void OnJoinRoom(const Sender &sender, const SmartPtr<Messages::JoinRoom> &joinRoom);
+    void OnQuickJoin(const Sender &sender, const SmartPtr<Messages::QuickJoin> &quickJoin);
+    void OnStartGame(const Sender &sender, const SmartPtr<Messages::StartGame> &startGame);
+    void OnPlayerInputs(const Sender &sender, const SmartPtr<Messages::PlayerInputs> &playerInputs);
+    void OnPlayerInputsWindow(const Sender &sender, const SmartPtr<Messages::PlayerInputsWindow> &inputsWindow);
+
+    uint32_t GetRoomsCount() const;
+    Handle<GameRoom> GetRoom(uint32_t roomId);
+    uint32_t NewRoom(Shard *shard, uint8_t playersCount);
+    void DestroyRoom(GameRoom *room);
+
+    // a room is in openRooms under its joined count, it moves as players come and go
+    void OpenRoom(uint32_t roomId, GameRoom *room);
+    void CloseRoom(GameRoom *room);
+    void AddPlayer(ENetPeer *peer, uint32_t roomId, GameRoom *room, const SmartPtr<Messages::JoinRoom> &joinRoom);
+
+    // peers keep the id of their room rather than a pointer, rooms move when their pool grows
+    Handle<GameRoom> GetPeerRoom(ENetPeer *peer);
+    static uint32_t GetPeerRoomId(ENetPeer *peer);
+    static void SetPeerRoom(ENetPeer *peer, uint32_t roomId);
+    static void ClearPeerRoom(ENetPeer *peer);
+
+    static uint32_t MakeRoomId(uint32_t shardIndex, uint32_t instanceId);
+
+    static void ServiceShardJob(void *data);
+    static void FlushShardJob(void *data);
+    static void UpdateRoomJob(void *data);
 public:
+    static const uint32_t kMaxWaitTime = 50; // ms, ENet still needs regular service for pings and resends
+    static const float kStatsInterval;
+    static const uint32_t kStatsMaxPeers = 8; // the slowest ones get a line each
+
+    static const size_t kMaxCaptureSize = 256 * 1024 * 1024; // bytes, a capture that grows past it gets saved and ends
+
+    // Playing rooms step on one of these slots of the room step, the least crowded when they start,
+    // so that the server steps a few rooms every couple of ms rather than all of them at once.
+    static const uint32_t kStepPhases = 16;
+
+    static const uint32_t kShardBits = 4; // room ids keep the owning shard in their low bits
+    static const uint32_t kMaxShards = 1 << kShardBits;
+
     ServerInstance();
     virtual ~ServerInstance();
 
-    bool Initialize(int port);
-    void Tick();
+    bool Initialize(int port, uint32_t shardsCount = 1);
+    void Tick(bool block = true);
 
     void RequestStop();
 
+    // ms until the next room step is due, kMaxWaitTime at most
+    uint32_t GetWaitTimeout() const;
+
+    // the step phase with the fewest playing rooms, the room gives it back when it ends
+    uint32_t TakeStepPhase();
+    void ReleaseStepPhase(uint32_t phase);
+
+    // Record every connect, disconnect and packet from now on, for seconds or until StopCapture
+    // (RequestStop stops it too). The capture is saved when it stops.
+    void StartCapture(const char *path, float seconds = .0f);
+    bool StopCapture();
+    bool IsCapturing() const;
+
+    // Queue a captured event on its shard, the next Tick handles it as if the shard's host received it.
+    // The host's peers stand in for the captured ones, what gets sent to them goes nowhere.
+    // Run the time server on a virtual clock set to the records' time, see THReplay.
+    void ReplayRecord(const PacketCapture::Record &record);
+
     void Send(ENetPeer *peer, const SmartPtr<Serializable> &object, MessageType messageType, uint8_t channel);
-    void Broadcast(const Array<ENetPeer*> &peers, const SmartPtr<Serializable> &object, MessageType messageType, uint8_t channel);
+
+    // what the last encoding of snapshot cost, sent to peersCount peers, and what it would have without a baseline
+    void AddSnapshotStats(const Messages::RoomSnapshot &snapshot, uint32_t peersCount);
+
+    // message counters, for whoever sends outside of Send
+    NetStats& GetNetStats();
+    // every connected peer of every shard, counted since the last stats interval
+    void GetPeersStats(Array<NetStats::PeerStats> &peersStats) const;
 
     static ServerInstance* Instance();
 };
 
+inline uint32_t
+ServerInstance::MakeRoomId(uint32_t shardIndex, uint32_t instanceId)
+{
+    return (instanceId << kShardBits) | shardIndex;
+}
+
+inline uint32_t
+ServerInstance::GetPeerRoomId(ENetPeer *peer)
+{
+    return (uint32_t)((uintptr_t)peer->data - 1);
+}
+
+inline void
+ServerInstance::SetPeerRoom(ENetPeer *peer, uint32_t roomId)
+{
+    peer->data = (void*)((uintptr_t)roomId + 1); // nullptr is no room
+}
+
+inline void
+ServerInstance::ClearPeerRoom(ENetPeer *peer)
+{
+    peer->data = nullptr;
+}
+
+inline bool
+ServerInstance::IsCapturing() const
+{
+    return capturing;
+}
+
+inline NetStats&
+ServerInstance::GetNetStats()
+{
+    return netStats;
+}
+
 inline ServerInstance*
 ServerInstance::Instance()
 {